@@ -14,6 +14,15 @@ restinio_path_handler_t *restinio_path_handler(
     const char *uri_path,
     bool directory);
 
+// File contents are kept in an LRU cache of at most max_bytes (entries are
+// revalidated against the file's mtime and size on every request); files of
+// at least sendfile_min_bytes bypass the cache and are sent with sendfile.
+// Either limit may be 0 to disable it.  Defaults are 32 MiB and 4 MiB.
+void restinio_path_handler_cache(
+    restinio_path_handler_t *handler,
+    size_t max_bytes,
+    size_t sendfile_min_bytes);
+
 restinio_response_t *restinio_path_handler_cb(
     void *arg,
     const char *method,
@@ -21,4 +30,23 @@ restinio_response_t *restinio_path_handler_cb(
     const char *body,
     size_t body_length);
 
+// Like restinio_path_handler_cb, registered with restinio_use_view, and
+// negotiates Content-Encoding for text, JavaScript, JSON and SVG files: a
+// precompressed sibling (file.zst, then file.gz) is sent when the client
+// accepts it and the sibling is not older than the file; otherwise cached
+// files are gzip-compressed once and the variant is kept with the entry.
+// Files sent with sendfile are only served from siblings.
+//
+// Responses carry a strong ETag (a hash of the content, kept with the cache
+// entry, or size and mtime for sendfile files) and Last-Modified, and
+// If-None-Match / If-Modified-Since are answered with a bodiless 304.  The
+// legacy callback gets the If-None-Match half from the library.
+//
+// Range requests (with If-Range) on the identity representation get a 206,
+// a multipart/byteranges body for several ranges, or a 416; slices are sent
+// straight from the cached copy or with sendfile, never buffered.
+restinio_response_t *restinio_path_handler_view_cb(
+    void *arg,
+    restinio_request_t *req);
+
 #endif
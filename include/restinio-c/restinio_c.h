@@ -7,6 +7,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,6 +22,13 @@ typedef struct restinio_header_s {
 struct restinio_response_s;
 typedef struct restinio_response_s restinio_response_t;
 
+// Borrowed view of an incoming request.  Every slice returned by the
+// restinio_request_* accessors points into Restinio's own buffers and stays
+// valid for the whole synchronous callback or, for detached requests, until
+// the response handle is finished.
+struct restinio_request_s;
+typedef struct restinio_request_s restinio_request_t;
+
 // if this returns NULL, it is skipped
 typedef restinio_response_t *(*restinio_handle_request_cb)(
     void *arg,
@@ -40,8 +48,39 @@ typedef void (*restinio_handle_detached_request_cb)(
     void *response_handle /* Handle for finalizing response */
 );
 
+// View variants of the callbacks above; nothing is copied before they run.
+// For the detached variant, response_handle is passed to restinio_finish_detached*.
+typedef restinio_response_t *(*restinio_handle_request_view_cb)(
+    void *arg,
+    restinio_request_t *req
+);
+
+typedef void (*restinio_handle_detached_request_view_cb)(
+    void *arg,
+    restinio_request_t *req,
+    void *response_handle
+);
+
 typedef void (*restinio_destroy_cb)(restinio_response_t *r);
 
+// Told, on an I/O thread, that a detached request can no longer be answered
+typedef void (*restinio_cancel_cb)(void *arg, void *response_handle);
+
+// Receives a request body piece by piece (see restinio_route_body_chunks);
+// returning false answers 400 and skips the route's callback.
+typedef bool (*restinio_body_chunk_cb)(
+    void *arg,
+    restinio_request_t *req,
+    const void *data,
+    size_t length);
+
+// Releases a caller-owned body once it has been written to the socket (or
+// the connection closed).  free() fits when arg is the buffer itself.
+typedef void (*restinio_release_cb)(void *arg);
+
+// When destroy is set the body is sent in place, without a copy, and destroy
+// runs once the bytes have been written, possibly on another thread.  A zero
+// response_length means response is a NUL-terminated string.
 struct restinio_response_s {
     char *response;
     size_t response_length;
@@ -53,36 +92,453 @@ struct restinio_response_s {
     restinio_destroy_cb destroy;
 };
 
+// Pooled response builder.  Headers and body chunks are appended into buffers
+// owned by the library and recycled per thread, so a handler does no malloc
+// or strdup of its own.  restinio_response_builder_finish() returns a
+// restinio_response_t to hand back from a callback (or to
+// restinio_finish_detached_response); the body is then sent straight from
+// the builder, which is recycled once it has been written.  A finished
+// response that is never sent must be released through its destroy callback.
+struct restinio_response_builder_s;
+typedef struct restinio_response_builder_s restinio_response_builder_t;
+
+restinio_response_builder_t *restinio_response_builder(int status_code);
+
+void restinio_response_builder_header(
+    restinio_response_builder_t *rb,
+    const char *key,
+    const char *value);
+
+void restinio_response_builder_header_n(
+    restinio_response_builder_t *rb,
+    const char *key, size_t key_length,
+    const char *value, size_t value_length);
+
+// appends to the body
+void restinio_response_builder_body(
+    restinio_response_builder_t *rb,
+    const void *data,
+    size_t length);
+
+// appends a buffer the library sends in place; release(release_arg) runs
+// once it has been written or the response is dropped
+void restinio_response_builder_body_owned(
+    restinio_response_builder_t *rb,
+    const void *data,
+    size_t length,
+    restinio_release_cb release,
+    void *release_arg);
+
+// appends a slice of a file, sent with sendfile (length 0 means up to the
+// end of the file); returns false if the file cannot be opened
+bool restinio_response_builder_file(
+    restinio_response_builder_t *rb,
+    const char *path,
+    uint64_t offset,
+    uint64_t length);
+
+// Sets a strong ETag (quoted if it is not already).  With etag NULL the tag
+// is a hash of the body, computed by restinio_response_builder_finish() (and
+// omitted if the body has file slices).  A 200 response carrying an ETag
+// that matches the request's If-None-Match is sent as a bodiless 304.
+void restinio_response_builder_etag(
+    restinio_response_builder_t *rb,
+    const char *etag);
+
+restinio_response_t *restinio_response_builder_finish(restinio_response_builder_t *rb);
+
+// Streaming response for large or incrementally produced bodies, sent with
+// chunked transfer encoding.  restinio_stream_begin() consumes a detached
+// response handle and sends the status line and headers immediately.  A
+// stream must be used from one thread at a time.
+struct restinio_stream_s;
+typedef struct restinio_stream_s restinio_stream_t;
+
+// Called once the bytes still queued for the socket drop to half the high
+// watermark after an append reported backpressure.  Runs on an I/O thread.
+typedef void (*restinio_stream_drain_cb)(void *arg);
+
+restinio_stream_t *restinio_stream_begin(
+    void *response_handle,
+    int status_code,
+    restinio_header_t *headers);
+
+// high_watermark of 0 (the default) disables backpressure reporting
+void restinio_stream_set_backpressure(
+    restinio_stream_t *stream,
+    size_t high_watermark,
+    restinio_stream_drain_cb on_drain,
+    void *arg);
+
+// Queue a chunk (copied).  Returns false when more than high_watermark bytes
+// are waiting to be written; the chunk is still queued (and flushed), but
+// the producer should pause until on_drain fires.
+bool restinio_stream_append(
+    restinio_stream_t *stream,
+    const void *data,
+    size_t length);
+
+// Like restinio_stream_append, without the copy; release(release_arg) runs
+// once the chunk has been written.
+bool restinio_stream_append_owned(
+    restinio_stream_t *stream,
+    const void *data,
+    size_t length,
+    restinio_release_cb release,
+    void *release_arg);
+
+// Start writing the queued chunks (done automatically every 64 KiB)
+void restinio_stream_flush(restinio_stream_t *stream);
+
+// bytes appended but not yet written to the socket
+size_t restinio_stream_pending(const restinio_stream_t *stream);
+
+// true once a write failed (typically the client went away)
+bool restinio_stream_failed(const restinio_stream_t *stream);
+
+// Writes the terminating chunk and frees the stream
+void restinio_stream_finish(restinio_stream_t *stream);
+
+typedef enum {
+    RESTINIO_ACCESS_LOG_COMMON,     // Common Log Format plus connection and timings
+    RESTINIO_ACCESS_LOG_JSON        // one JSON object per line
+} restinio_access_log_format_t;
+
 typedef struct {
     bool enable_ssl;        // if off, the following are ignored
-    const char *cert_file;
-    const char *key_file;
+    const char *cert_file;  // PEM certificate chain
+    const char *key_file;   // PEM private key
 
-    bool enable_http2;       // if the client supports it (allow http/2 upgrade)
+    bool enable_http2;       // ignored: HTTP/2 is not supported (Restinio
+                             // serves HTTP/1.1 only), so setting it only
+                             // logs a warning; over TLS, ALPN selects http/1.1
     bool enable_keepalive;   // if the client supports it
     bool enable_thread_pool; // as opposed to running on a single thread
     int thread_pool_size;    // number of worker threads if enable_thread_pool
     unsigned short port;     // port number to bind the server
     const char *address;     // address to bind the server (e.g., "0.0.0.0")
+
+    size_t max_connections;  // open connections at once, 0 for no limit;
+                             // the acceptor waits while the limit is reached
+    size_t max_in_flight;    // requests being handled at once (detached and
+                             // streaming ones included), 0 for no limit;
+                             // requests over it get a 503 with Retry-After
+
+    // Zero selects the default for every field below.
+    uint32_t read_timeout_ms;    // wait for the next request; 15 s with
+                                 // keep-alive, 60 s without
+    uint32_t write_timeout_ms;   // write one response, 120 s
+    uint32_t handler_timeout_ms; // a handler (or detached request) to
+                                 // produce its response, 120 s
+    size_t buffer_size;          // socket read buffer, Restinio's 4 KiB
+    size_t max_pipelined_requests; // requests read ahead per connection, 1
+    size_t concurrent_accepts;   // accept operations kept pending, 1
+    bool separate_accept_and_create_connect; // create connections off the
+                                             // acceptor's thread
+    bool tcp_nodelay;            // disable Nagle on accepted sockets
+    bool reuse_port;             // SO_REUSEADDR and SO_REUSEPORT on the listener
+
+    // Sharded mode: instead of one io_context shared by the thread pool,
+    // run this many listeners on the same port with SO_REUSEPORT, each on
+    // its own single-threaded io_context pinned to a CPU, and let the
+    // kernel spread connections across them.  They share the server's
+    // routes.  enable_thread_pool and thread_pool_size are then ignored,
+    // and max_connections applies to each shard.  0 for the pooled mode.
+    int shards;
+
+    // Worker pool for routes marked with restinio_route_blocking: threads
+    // (0 for one per CPU) and the queue depth of each (0 for 256).
+    int worker_threads;
+    size_t worker_queue_depth;
+
+    // With enable_ssl: sessions kept for resumption by session ID (0 for
+    // 20480, five minutes each), and whether to turn session tickets off.
+    size_t tls_session_cache_size;
+    bool tls_disable_tickets;
+
+    // Count requests and record latencies per route; see
+    // restinio_route_metrics and restinio_server_use_metrics.
+    bool enable_metrics;
+
+    // Access log: one line per response (method, target, status, bytes,
+    // queue/handler/total time, connection id), queued in a per-thread ring
+    // and written by a background thread, so the request path never waits
+    // on the file; entries that find their ring full are dropped and counted.
+    const char *access_log_path;    // NULL for no access log
+    restinio_access_log_format_t access_log_format;
+    size_t access_log_ring_entries; // per thread, 0 for 1024
+
+    // Largest request body Restinio will read; past it the connection is
+    // closed mid-upload.  0 takes the largest restinio_route_max_body_size
+    // when every route sets one, and no limit otherwise.
+    size_t max_body_size;
 } restinio_options_t;
 
+// Options are versioned by size, as in zlib: restinio_init and
+// restinio_server_create pass sizeof(restinio_options_t) as seen by the
+// caller, so fields added later stay zeroed for older callers.  The
+// functions of the same name read only the original fields.
+void restinio_init_ex(const restinio_options_t *options, size_t options_size);
+
 void restinio_init(
     restinio_options_t *options
 );
+#define restinio_init(options) \
+    restinio_init_ex((options), sizeof(restinio_options_t))
+
+// A registered route.  The handle stays valid until its server is destroyed
+// and is used to set per-route options before the server runs.
+struct restinio_route_s;
+typedef struct restinio_route_s restinio_route_t;
+
+restinio_route_t *restinio_use(const char *method,
+                               const char *path,
+                               restinio_handle_request_cb cb,
+                               void *arg);
+
+restinio_route_t *restinio_use_detached(const char *method,
+                                        const char *path,
+                                        restinio_handle_detached_request_cb cb,
+                                        void *arg);
+
+restinio_route_t *restinio_use_view(const char *method,
+                                    const char *path,
+                                    restinio_handle_request_view_cb cb,
+                                    void *arg);
+
+restinio_route_t *restinio_use_detached_view(const char *method,
+                                             const char *path,
+                                             restinio_handle_detached_request_view_cb cb,
+                                             void *arg);
+
+// A constant response (health checks, swagger.json): headers and body are
+// copied once here and every request is answered from that copy, without a
+// callback or a per-request body copy.  2xx responses get a strong ETag
+// (a hash of the body, unless headers carry one) and If-None-Match is
+// answered with a 304.
+restinio_route_t *restinio_use_static(const char *method,
+                                      const char *path,
+                                      int status_code,
+                                      const restinio_header_t *headers,
+                                      const void *body,
+                                      size_t body_length);
+
+// Opt the route into gzip for clients that accept it.  Successful responses
+// of at least min_bytes with a textual (or missing) Content-Type and no
+// Content-Encoding of their own are compressed before they are sent, and
+// Vary: Accept-Encoding is added.  File slices are never compressed.
+void restinio_route_compress(restinio_route_t *route, size_t min_bytes);
+
+// Run the route's synchronous callback on the server's worker pool instead
+// of the I/O thread, for handlers that block (database calls, disk reads).
+// The pool is work-stealing with a bounded queue per worker; when every
+// queue is full the request gets a 503 with Retry-After.  A blocking
+// callback that returns NULL gets a 501 rather than falling through to the
+// next route.  Detached routes are unaffected.
+void restinio_route_blocking(restinio_route_t *route);
+
+// Requests to the route with a body over max_bytes get a 413 and the
+// connection is closed, without running its callback (0 removes the limit).
+// Bodies are read in full before routing, so only the server-wide
+// max_body_size stops an upload while it is being read.
+void restinio_route_max_body_size(restinio_route_t *route, size_t max_bytes);
+
+// Hands the request body to cb (with the route's arg) before the route's
+// callback runs: once per chunk, in order, for a chunked upload, otherwise
+// once with the whole body.  Ingest routes can parse or forward the pieces
+// and answer from what they kept rather than the raw body.  Runs on the
+// worker pool for blocking routes.
+void restinio_route_body_chunks(restinio_route_t *route, restinio_body_chunk_cb cb);
+
+// Detached requests on the route that are not finished within timeout_ms
+// get a 504 and are cancelled (0 removes the deadline).
+void restinio_route_deadline(restinio_route_t *route, uint32_t timeout_ms);
 
-void restinio_use(const char *method,
-                  const char *path,
-                  restinio_handle_request_cb cb,
-                  void *arg);
+// cb (with the route's arg) runs once when a detached request on the route
+// is cancelled: its connection closed, or its deadline passed.  The handle
+// must still be finished, which after cancellation only releases it.
+void restinio_route_on_cancel(restinio_route_t *route, restinio_cancel_cb cb);
+
+// Cache the route's responses to GET requests, keyed by method, target and
+// the values of the request headers listed in vary (comma-separated, NULL
+// for none).  Entries live for ttl_ms (0: until evicted) within max_bytes
+// (0: 16 MiB), least recently used first out; a response larger than
+// max_bytes is never stored.  Only in-memory 200s without Set-Cookie or
+// Cache-Control: no-store/private are stored.  Concurrent
+// misses on one key wait for the first and share its response, so the
+// callback runs once; if that response is not shareable (Set-Cookie,
+// private, no-store) each waiter runs the callback itself, on its own I/O
+// thread or the worker pool, and falls through to later routes on NULL
+// like any other request.  For synchronous and blocking routes; detached
+// routes ignore it.
+void restinio_route_cache(restinio_route_t *route,
+                          uint32_t ttl_ms,
+                          size_t max_bytes,
+                          const char *vary);
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;        // the callback ran
+    uint64_t coalesced;     // answered by a concurrent miss on the same key
+    uint64_t stores;
+    uint64_t evictions;     // to stay within max_bytes
+    uint64_t expirations;   // found past their ttl
+    size_t entries;
+    size_t bytes;
+} restinio_cache_stats_t;
+
+// false (and zeroes) if the route has no cache
+bool restinio_route_cache_stats(const restinio_route_t *route, restinio_cache_stats_t *stats);
 
-void restinio_use_detached(const char *method,
-                           const char *path,
-                           restinio_handle_detached_request_cb cb,
-                           void *arg);
 void restinio_run();
 
+// restinio_server_drain on the default server
+bool restinio_drain(uint32_t timeout_ms);
+
 void restinio_destroy();
 
+// Independent server instances, each with its own routes, listener and
+// thread pool, so one process can serve several ports (public API, admin,
+// metrics).  restinio_init, _use, _run and _destroy drive a default one.
+struct restinio_server_s;
+typedef struct restinio_server_s restinio_server_t;
+
+// options are copied; NULL leaves every option zeroed
+restinio_server_t *restinio_server_create_ex(const restinio_options_t *options,
+                                             size_t options_size);
+
+restinio_server_t *restinio_server_create(const restinio_options_t *options);
+#define restinio_server_create(options) \
+    restinio_server_create_ex((options), sizeof(restinio_options_t))
+
+restinio_route_t *restinio_server_use(restinio_server_t *server,
+                                      const char *method,
+                                      const char *path,
+                                      restinio_handle_request_cb cb,
+                                      void *arg);
+
+restinio_route_t *restinio_server_use_detached(restinio_server_t *server,
+                                               const char *method,
+                                               const char *path,
+                                               restinio_handle_detached_request_cb cb,
+                                               void *arg);
+
+restinio_route_t *restinio_server_use_view(restinio_server_t *server,
+                                           const char *method,
+                                           const char *path,
+                                           restinio_handle_request_view_cb cb,
+                                           void *arg);
+
+restinio_route_t *restinio_server_use_detached_view(restinio_server_t *server,
+                                                    const char *method,
+                                                    const char *path,
+                                                    restinio_handle_detached_request_view_cb cb,
+                                                    void *arg);
+
+restinio_route_t *restinio_server_use_static(restinio_server_t *server,
+                                             const char *method,
+                                             const char *path,
+                                             int status_code,
+                                             const restinio_header_t *headers,
+                                             const void *body,
+                                             size_t body_length);
+
+// Binds the listener and starts the thread pool; returns once connections
+// are accepted, or false if the address could not be bound.  Routes must be
+// registered before this call.
+bool restinio_server_run(restinio_server_t *server);
+
+// Stops accepting, closes connections and joins the pool threads; returns
+// as soon as they have exited.  Not async-signal-safe.  The server may be
+// run again afterwards.
+void restinio_server_stop(restinio_server_t *server);
+
+// Graceful shutdown: new requests are answered with 503 and Connection:
+// close, responses to requests already in flight (synchronous, detached and
+// streams) close their keep-alive connections, and once none are left or
+// timeout_ms has passed the server is stopped.  Returns false if requests
+// were still in flight at the deadline; their handles stay valid and must
+// still be finished.  Blocking requests still queued for a worker at the
+// deadline are answered with 503 instead of being run.
+bool restinio_server_drain(restinio_server_t *server, uint32_t timeout_ms);
+
+// Reloads cert_file and key_file for a server running with enable_ssl;
+// handshakes from then on use the new certificate, connections already
+// established keep theirs, and cached sessions stay resumable.  Safe to call
+// from any thread.  On failure the current certificate stays in use.
+bool restinio_server_reload_tls(restinio_server_t *server);
+
+// Requests accepted and not yet answered; *detached (if not NULL) receives
+// how many of them are detached handles or open streams.
+size_t restinio_server_in_flight(const restinio_server_t *server, size_t *detached);
+
+typedef struct {
+    size_t threads;
+    size_t queued;          // waiting for a worker
+    size_t running;
+    uint64_t completed;
+    uint64_t rejected;      // answered with 503, every queue was full
+    uint64_t wait_us_total; // summed queue wait of the started requests
+    uint64_t wait_us_max;
+} restinio_worker_stats_t;
+
+// Fills *stats for the worker pool; false (and zeroes) if the server has
+// no blocking routes.
+bool restinio_server_worker_stats(const restinio_server_t *server,
+                                  restinio_worker_stats_t *stats);
+
+// Latency histogram in microseconds.  Buckets are log-linear: four per
+// power of two, so a bucket is at most 25% wide; bucket i holds values up
+// to restinio_histogram_bucket_high(i) and the last one is open-ended.
+#define RESTINIO_HISTOGRAM_BUCKETS 128
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t buckets[RESTINIO_HISTOGRAM_BUCKETS];
+} restinio_histogram_t;
+
+uint64_t restinio_histogram_bucket_high(size_t bucket);
+
+// Upper bound of the bucket holding the given percentile (0-100)
+uint64_t restinio_histogram_percentile(const restinio_histogram_t *histogram,
+                                       double percentile);
+
+typedef struct {
+    uint64_t requests;
+    uint64_t status[6];             // [1] 1xx .. [5] 5xx, [0] anything else
+    uint64_t bytes_in;              // request bodies
+    uint64_t bytes_out;             // response bodies, streams not included
+    restinio_histogram_t queue;     // dispatch until the callback runs
+    restinio_histogram_t handler;   // callback start until the response
+                                    // (detached: until restinio_finish_*)
+    restinio_histogram_t total;     // dispatch until the response
+} restinio_route_metrics_t;
+
+// Merges the per-thread counters of a route; false if the route's server
+// does not have enable_metrics set or has not run yet.
+bool restinio_route_metrics(const restinio_route_t *route, restinio_route_metrics_t *metrics);
+
+typedef struct {
+    size_t in_flight;
+    size_t detached;
+    uint64_t unrouted;              // 501, no route gave a response
+    uint64_t rejected_overload;     // 503, over max_in_flight or worker queues full
+    uint64_t rejected_draining;     // 503 while draining
+    uint64_t access_log_dropped;    // entries lost to a full ring
+} restinio_server_metrics_t;
+
+void restinio_server_metrics(const restinio_server_t *server, restinio_server_metrics_t *metrics);
+
+// Registers GET path serving every counter and histogram of the server in
+// the Prometheus text format, and turns enable_metrics on.
+restinio_route_t *restinio_server_use_metrics(restinio_server_t *server, const char *path);
+
+// Stops the server if needed and frees it with its routes.  Detached
+// requests must have been finished first.
+void restinio_server_destroy(restinio_server_t *server);
+
 void restinio_finish_detached(
     void *response_handle,
     int status_code,
@@ -90,6 +546,37 @@ void restinio_finish_detached(
     size_t response_body_length,
     restinio_header_t *headers);
 
+// Like restinio_finish_detached, but the body is sent without a copy and
+// release(release_arg) runs only after it has been written.
+void restinio_finish_detached_owned(
+    void *response_handle,
+    int status_code,
+    const void *response_body,
+    size_t response_body_length,
+    restinio_header_t *headers,
+    restinio_release_cb release,
+    void *release_arg);
+
+// Sends a restinio_response_t (for example one from a response builder) and
+// releases it through its destroy callback.  Called off the I/O threads,
+// the response is prepared (compressed, counted) on the calling thread and
+// queued; the I/O thread sends everything queued in one wakeup.
+void restinio_finish_detached_response(
+    void *response_handle,
+    restinio_response_t *response);
+
+// true once a detached request has been cancelled (see
+// restinio_route_on_cancel), so long-running work can be abandoned early.
+// Finishing a cancelled handle sends nothing and releases the response.
+bool restinio_detached_cancelled(const void *response_handle);
+
+// restinio_finish_detached_response for count handles at once; a worker
+// finishing a batch usually costs each I/O context a single wakeup
+void restinio_finish_detached_many(
+    void *const *response_handles,
+    restinio_response_t *const *responses,
+    size_t count);
+
 void restinio_finish_detached_error(
     void *response_handle,
     int status_code,
@@ -104,6 +591,70 @@ void restinio_finish_detached_json(
     const char *response_body,
     size_t response_body_length);
 
+// Request view accessors (length may be NULL)
+const char *restinio_request_method(const restinio_request_t *req, size_t *length);
+const char *restinio_request_target(const restinio_request_t *req, size_t *length);
+const char *restinio_request_body(const restinio_request_t *req, size_t *length);
+
+size_t restinio_request_header_count(const restinio_request_t *req);
+
+// returns false if index is out of range
+bool restinio_request_header_at(
+    const restinio_request_t *req,
+    size_t index,
+    const char **name, size_t *name_length,
+    const char **value, size_t *value_length);
+
+// Header lookup by (case-insensitive) name, NULL if the field is absent
+const char *restinio_request_header(
+    const restinio_request_t *req,
+    const char *name,
+    size_t *length);
+
+// true if If-None-Match lists etag (weak comparison) or "*"; lets a view
+// handler skip building a body the client already has
+bool restinio_request_etag_matches(
+    const restinio_request_t *req,
+    const char *etag);
+
+// true if the Accept-Encoding header admits the content coding (for
+// example "gzip"), honouring q=0 and "*"
+bool restinio_request_accepts_encoding(
+    const restinio_request_t *req,
+    const char *coding);
+
+// Query-string parameters, percent-decoded.  The query is parsed once, on
+// first use, and cached on the request.
+size_t restinio_request_query_count(const restinio_request_t *req);
+
+bool restinio_request_query_at(
+    const restinio_request_t *req,
+    size_t index,
+    const char **name, size_t *name_length,
+    const char **value, size_t *value_length);
+
+// NULL if the parameter is absent
+const char *restinio_request_query(
+    const restinio_request_t *req,
+    const char *name,
+    size_t *length);
+
+// Segments captured by {name} placeholders in the path the route was
+// registered with, e.g. restinio_use_view("GET", "/users/{id}", ...).
+size_t restinio_request_path_param_count(const restinio_request_t *req);
+
+bool restinio_request_path_param_at(
+    const restinio_request_t *req,
+    size_t index,
+    const char **name, size_t *name_length,
+    const char **value, size_t *value_length);
+
+// NULL if the route has no such parameter
+const char *restinio_request_path_param(
+    const restinio_request_t *req,
+    const char *name,
+    size_t *length);
+
 #ifdef __cplusplus
 }
 #endif
@@ -3,142 +3,686 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "restinio-c/handlers/restinio_path.h"
+#include "../restinio_http.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define DEFAULT_CACHE_BYTES (32u << 20)
+#define DEFAULT_SENDFILE_MIN_BYTES (4u << 20)
+#define GZIP_MIN_BYTES 256   // smaller files are not worth compressing
+
+// A file's contents, shared between the cache and in-flight responses.
+// `refs` counts responses still writing it; the cache holds the entry
+// without a reference and frees it once evicted and unreferenced.
+typedef struct file_entry_s {
+    char *path;
+    char *data;
+    size_t size;
+    struct timespec mtime;
+    uint64_t hash;          // of path
+    uint64_t content_hash;  // of data, the strong ETag
+
+    // gzip variant, compressed on first demand and freed with the entry;
+    // NULL when compression did not pay off
+    char *gzip_data;
+    size_t gzip_size;
+    bool gzip_done;
+
+    int refs;
+    bool cached;
+    struct file_cache_s *cache;
+    struct file_entry_s *prev, *next;  // LRU list, most recent first
+    struct file_entry_s *bucket_next;
+} file_entry_t;
+
+typedef struct file_cache_s {
+    pthread_mutex_t lock;
+    file_entry_t **buckets;
+    size_t num_buckets, num_entries;
+    file_entry_t *head, *tail;
+    size_t bytes, max_bytes;
+} file_cache_t;
 
 // Helper function declarations
 static char *load_file_into_memory(const char *filepath, size_t *out_size);
 static const char *guess_mime_type(const char *filename);
 static restinio_response_t *make_response(
     const char *body, const char *content_type, int status_code, const char *status_message);
-static void destroy_response(restinio_response_t *response);
+static restinio_response_t *serve_file(
+    restinio_path_handler_t *handler, const char *filepath, const restinio_request_t *req);
+static void cache_trim(file_cache_t *cache);
 
 // Structure for handling path mappings
 struct restinio_path_handler_s {
     const char *uri_path;   // URL path to match (e.g., "/swagger.json" or "/docs")
     const char *source_path; // Local file or directory path
     bool is_directory;      // If true, source_path is a directory
+
+    // files at least this large bypass the cache; atomic because
+    // restinio_path_handler_cache() may change it while requests run
+    _Atomic size_t sendfile_min_bytes;
+    file_cache_t cache;
 };
 
-// Request handler function
-restinio_response_t *restinio_path_handler_cb(
-    void *arg,
+// Maps uri to a file and serves it.  req is NULL for the legacy callback,
+// which cannot see request headers and so never negotiates an encoding.
+static restinio_response_t *handle_request(
+    restinio_path_handler_t *handler,
     const char *method,
     const char *uri,
-    const char *body,
-    size_t body_length)
+    const restinio_request_t *req)
 {
-    restinio_path_handler_t *handler = (restinio_path_handler_t *)arg;
-
     // Ensure it's a GET request
     if (strcasecmp(method, "GET") != 0) {
         return make_response("Method Not Allowed", "text/plain", 405, "Method Not Allowed");
     }
 
+    // The query string never names a file
+    size_t uri_length = strcspn(uri, "?#");
+
     // Handle single file requests
     if (!handler->is_directory) {
-        if (strcmp(uri, handler->uri_path) == 0) {
-            size_t file_size = 0;
-            char *file_contents = load_file_into_memory(handler->source_path, &file_size);
-            if (!file_contents) {
-                return make_response("File not found", "text/plain", 404, "Not Found");
-            }
-
-            const char *mime_type = guess_mime_type(handler->source_path);
-            restinio_response_t *resp = make_response(file_contents, mime_type, 200, "OK");
-            free(file_contents);
-            resp->destroy = destroy_response;
-            return resp;
+        if (uri_length == strlen(handler->uri_path) &&
+            strncmp(uri, handler->uri_path, uri_length) == 0) {
+            return serve_file(handler, handler->source_path, req);
         }
     }
     // Handle directory-based file requests
     else {
-        if (strncmp(uri, handler->uri_path, strlen(handler->uri_path)) == 0) {
-            const char *subpath = uri + strlen(handler->uri_path);
-            if (*subpath == '\0') {
+        size_t prefix_length = strlen(handler->uri_path);
+        if (strncmp(uri, handler->uri_path, prefix_length) == 0) {
+            const char *subpath = uri + prefix_length;
+            int subpath_length = (int)(uri_length - prefix_length);
+            if (subpath_length == 0) {
                 subpath = "/index.html";  // Default to index.html
+                subpath_length = (int)strlen(subpath);
             }
 
             char filepath[512];
-            snprintf(filepath, sizeof(filepath), "%s%s", handler->source_path, subpath);
-
-            size_t file_size = 0;
-            char *file_contents = load_file_into_memory(filepath, &file_size);
-            if (!file_contents) {
-                return make_response("File not found", "text/plain", 404, "Not Found");
-            }
-
-            const char *mime_type = guess_mime_type(filepath);
-            restinio_response_t *resp = make_response(file_contents, mime_type, 200, "OK");
-            free(file_contents);
-            resp->destroy = destroy_response;
-            return resp;
+            snprintf(filepath, sizeof(filepath), "%s%.*s", handler->source_path, subpath_length, subpath);
+            return serve_file(handler, filepath, req);
         }
     }
 
     return NULL;
 }
 
+// Request handler function
+restinio_response_t *restinio_path_handler_cb(
+    void *arg,
+    const char *method,
+    const char *uri,
+    const char *body,
+    size_t body_length)
+{
+    (void)body;
+    (void)body_length;
+    return handle_request((restinio_path_handler_t *)arg, method, uri, NULL);
+}
+
+restinio_response_t *restinio_path_handler_view_cb(
+    void *arg,
+    restinio_request_t *req)
+{
+    return handle_request((restinio_path_handler_t *)arg,
+                          restinio_request_method(req, NULL),
+                          restinio_request_target(req, NULL),
+                          req);
+}
+
 // Factory function to create path handlers
 restinio_path_handler_t *restinio_path_handler(
     const char *source_path,
     const char *uri_path,
     bool directory)
 {
-    restinio_path_handler_t *handler = (restinio_path_handler_t *)malloc(sizeof(restinio_path_handler_t));
+    restinio_path_handler_t *handler = (restinio_path_handler_t *)calloc(1, sizeof(restinio_path_handler_t));
     if (!handler) return NULL;
 
     handler->uri_path = strdup(uri_path);
     handler->source_path = strdup(source_path);
     handler->is_directory = directory;
+    atomic_init(&handler->sendfile_min_bytes, DEFAULT_SENDFILE_MIN_BYTES);
+    handler->cache.max_bytes = DEFAULT_CACHE_BYTES;
+    pthread_mutex_init(&handler->cache.lock, NULL);
     return handler;
 }
 
+void restinio_path_handler_cache(
+    restinio_path_handler_t *handler,
+    size_t max_bytes,
+    size_t sendfile_min_bytes)
+{
+    pthread_mutex_lock(&handler->cache.lock);
+    handler->cache.max_bytes = max_bytes;
+    atomic_store_explicit(&handler->sendfile_min_bytes, sendfile_min_bytes, memory_order_relaxed);
+    cache_trim(&handler->cache);
+    pthread_mutex_unlock(&handler->cache.lock);
+}
+
 //-----------------------------------------------------
-// Helper: create a restinio_response_t
+// File cache
 //-----------------------------------------------------
-static restinio_response_t *make_response(
-    const char *body, const char *content_type, int status_code, const char *status_message)
+static uint64_t hash_bytes(const void *p, size_t len)
 {
-    restinio_response_t *resp = (restinio_response_t *)calloc(1, sizeof(*resp));
-    if (!resp) {
-        fprintf(stderr, "Out of memory creating response\n");
+    // FNV-1a
+    const unsigned char *s = (const unsigned char *)p;
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void free_entry(file_entry_t *entry)
+{
+    free(entry->path);
+    free(entry->data);
+    free(entry->gzip_data);
+    free(entry);
+}
+
+static void lru_unlink(file_cache_t *cache, file_entry_t *entry)
+{
+    if (entry->prev) entry->prev->next = entry->next;
+    else cache->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else cache->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void lru_push_front(file_cache_t *cache, file_entry_t *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head) cache->head->prev = entry;
+    else cache->tail = entry;
+    cache->head = entry;
+}
+
+// caller holds the lock
+static void cache_remove(file_cache_t *cache, file_entry_t *entry)
+{
+    file_entry_t **pp = &cache->buckets[entry->hash & (cache->num_buckets - 1)];
+    while (*pp != entry)
+        pp = &(*pp)->bucket_next;
+    *pp = entry->bucket_next;
+    lru_unlink(cache, entry);
+    cache->bytes -= entry->size + entry->gzip_size;
+    cache->num_entries--;
+    entry->cached = false;
+    if (!entry->refs)
+        free_entry(entry);
+}
+
+// Evicts least recently used entries until the cache fits max_bytes.
+// caller holds the lock
+static void cache_trim(file_cache_t *cache)
+{
+    while (cache->tail && cache->bytes > cache->max_bytes)
+        cache_remove(cache, cache->tail);
+}
+
+// caller holds the lock
+static file_entry_t *cache_find(file_cache_t *cache, const char *path, uint64_t hash)
+{
+    if (!cache->num_buckets)
+        return NULL;
+    file_entry_t *entry = cache->buckets[hash & (cache->num_buckets - 1)];
+    while (entry && (entry->hash != hash || strcmp(entry->path, path)))
+        entry = entry->bucket_next;
+    return entry;
+}
+
+// caller holds the lock
+static void cache_insert(file_cache_t *cache, file_entry_t *entry)
+{
+    if (cache->num_entries >= cache->num_buckets) {
+        size_t num_buckets = cache->num_buckets ? cache->num_buckets * 2 : 64;
+        file_entry_t **buckets = (file_entry_t **)calloc(num_buckets, sizeof(file_entry_t *));
+        if (!buckets)
+            return;
+        for (size_t i = 0; i < cache->num_buckets; i++) {
+            file_entry_t *e = cache->buckets[i];
+            while (e) {
+                file_entry_t *next = e->bucket_next;
+                e->bucket_next = buckets[e->hash & (num_buckets - 1)];
+                buckets[e->hash & (num_buckets - 1)] = e;
+                e = next;
+            }
+        }
+        free(cache->buckets);
+        cache->buckets = buckets;
+        cache->num_buckets = num_buckets;
+    }
+
+    while (cache->tail && cache->bytes + entry->size > cache->max_bytes)
+        cache_remove(cache, cache->tail);
+
+    entry->bucket_next = cache->buckets[entry->hash & (cache->num_buckets - 1)];
+    cache->buckets[entry->hash & (cache->num_buckets - 1)] = entry;
+    lru_push_front(cache, entry);
+    cache->bytes += entry->size;
+    cache->num_entries++;
+    entry->cached = true;
+}
+
+// takes another reference for a further response piece
+static void retain_entry(file_entry_t *entry)
+{
+    pthread_mutex_lock(&entry->cache->lock);
+    entry->refs++;
+    pthread_mutex_unlock(&entry->cache->lock);
+}
+
+// release callback for response bodies that point into an entry
+static void release_entry(void *arg)
+{
+    file_entry_t *entry = (file_entry_t *)arg;
+    file_cache_t *cache = entry->cache;
+    pthread_mutex_lock(&cache->lock);
+    bool unused = --entry->refs == 0 && !entry->cached;
+    pthread_mutex_unlock(&cache->lock);
+    if (unused)
+        free_entry(entry);
+}
+
+static bool same_mtime(const struct timespec *a, const struct timespec *b)
+{
+    return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+// Returns a referenced entry for filepath, loading it if the cached copy is
+// missing or stale.  NULL if the file cannot be read.
+static file_entry_t *acquire_entry(file_cache_t *cache, const char *filepath, const struct stat *st)
+{
+    uint64_t hash = hash_bytes(filepath, strlen(filepath));
+
+    pthread_mutex_lock(&cache->lock);
+    file_entry_t *entry = cache_find(cache, filepath, hash);
+    if (entry && entry->size == (size_t)st->st_size && same_mtime(&entry->mtime, &st->st_mtim)) {
+        entry->refs++;
+        lru_unlink(cache, entry);
+        lru_push_front(cache, entry);
+        pthread_mutex_unlock(&cache->lock);
+        return entry;
+    }
+    if (entry)
+        cache_remove(cache, entry);
+    pthread_mutex_unlock(&cache->lock);
+
+    // load outside the lock; a concurrent miss may load the same file twice
+    entry = (file_entry_t *)calloc(1, sizeof(file_entry_t));
+    if (!entry)
+        return NULL;
+    entry->data = load_file_into_memory(filepath, &entry->size);
+    entry->path = strdup(filepath);
+    if (!entry->data || !entry->path) {
+        free_entry(entry);
         return NULL;
     }
+    entry->mtime = st->st_mtim;
+    entry->hash = hash;
+    entry->content_hash = hash_bytes(entry->data, entry->size);
+    entry->cache = cache;
+    entry->refs = 1;
+
+    pthread_mutex_lock(&cache->lock);
+    file_entry_t *existing = cache_find(cache, filepath, hash);
+    if (existing && existing->size == entry->size && same_mtime(&existing->mtime, &entry->mtime)) {
+        existing->refs++;
+        pthread_mutex_unlock(&cache->lock);
+        free_entry(entry);
+        return existing;
+    }
+    if (existing)
+        cache_remove(cache, existing);
+    if (entry->size <= cache->max_bytes)
+        cache_insert(cache, entry);
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
 
-    // Copy the body
-    if (body) {
-        resp->response = strdup(body);
-        resp->response_length = strlen(body);
+static char *gzip_bytes(const char *data, size_t size, size_t *out_size)
+{
+    if (size > UINT_MAX)
+        return NULL;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits 15 + 16 writes a gzip header and trailer; files are
+    // compressed once per cache entry, so spend the CPU on the best ratio
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        return NULL;
+
+    uLong bound = deflateBound(&zs, (uLong)size);
+    char *out = (char *)malloc(bound);
+    if (!out) {
+        deflateEnd(&zs);
+        return NULL;
+    }
+    zs.next_in = (Bytef *)data;
+    zs.avail_in = (uInt)size;
+    zs.next_out = (Bytef *)out;
+    zs.avail_out = (uInt)bound;
+    int rc = deflate(&zs, Z_FINISH);
+    *out_size = zs.total_out;
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+// Returns true if the entry has a gzip variant, compressing it on first use.
+// The caller holds a reference, so the entry cannot be freed underneath.
+static bool entry_gzip(file_cache_t *cache, file_entry_t *entry)
+{
+    pthread_mutex_lock(&cache->lock);
+    bool done = entry->gzip_done;
+    pthread_mutex_unlock(&cache->lock);
+    if (done)
+        return entry->gzip_data != NULL;
+
+    // compress outside the lock; a concurrent request may do the same work
+    size_t gzip_size = 0;
+    char *gzip_data = gzip_bytes(entry->data, entry->size, &gzip_size);
+    if (gzip_data && gzip_size >= entry->size) {
+        free(gzip_data);
+        gzip_data = NULL;
+        gzip_size = 0;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    if (!entry->gzip_done) {
+        entry->gzip_data = gzip_data;
+        entry->gzip_size = gzip_size;
+        entry->gzip_done = true;
+        if (entry->cached) {
+            cache->bytes += gzip_size;
+            cache_trim(cache);
+        }
+        gzip_data = NULL;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    free(gzip_data);
+    return entry->gzip_data != NULL;
+}
+
+static bool compressible_mime_type(const char *mime_type)
+{
+    return !strncmp(mime_type, "text/", 5) ||
+           !strcmp(mime_type, "application/javascript") ||
+           !strcmp(mime_type, "application/json") ||
+           !strcmp(mime_type, "image/svg+xml");
+}
+
+// Stats filepath + ext into variant and st; a precompressed sibling older
+// than the original is stale and ignored.
+static bool find_sibling(
+    const char *filepath, const char *ext, const struct stat *original,
+    char *variant, size_t variant_size, struct stat *st)
+{
+    if ((size_t)snprintf(variant, variant_size, "%s%s", filepath, ext) >= variant_size)
+        return false;
+    if (stat(variant, st) != 0 || !S_ISREG(st->st_mode))
+        return false;
+    return st->st_mtim.tv_sec > original->st_mtim.tv_sec ||
+           (st->st_mtim.tv_sec == original->st_mtim.tv_sec &&
+            st->st_mtim.tv_nsec >= original->st_mtim.tv_nsec);
+}
+
+// If-None-Match takes precedence over If-Modified-Since (RFC 9110 13.2.2)
+static bool not_modified(const restinio_request_t *req, const char *etag, time_t modified)
+{
+    if (!req)
+        return false;
+    // only GET and HEAD may be answered with a 304 (RFC 9110 13.1.2)
+    const char *method = restinio_request_method(req, NULL);
+    if (strcasecmp(method, "GET") && strcasecmp(method, "HEAD"))
+        return false;
+    if (restinio_request_header(req, "If-None-Match", NULL))
+        return restinio_request_etag_matches(req, etag);
+
+    const char *since = restinio_request_header(req, "If-Modified-Since", NULL);
+    time_t t;
+    return since && restinio_http_parse_date(since, &t) && modified <= t;
+}
+
+static restinio_response_t *not_found(void)
+{
+    return make_response("File not found", "text/plain", 404, "Not Found");
+}
+
+// If-Range holds either the strong ETag or the exact Last-Modified date
+// (RFC 9110 13.1.5); a mismatch means the client's copy is stale.
+static bool if_range_matches(const restinio_request_t *req, const char *etag, time_t modified)
+{
+    const char *if_range = restinio_request_header(req, "If-Range", NULL);
+    return !if_range || restinio_http_if_range_matches(if_range, etag, modified);
+}
+
+// Appends bytes [first, first + length) of the file, zero-copy from the
+// cached entry or as a sendfile slice
+static bool append_slice(
+    restinio_response_builder_t *rb, file_entry_t *entry,
+    const char *filepath, uint64_t first, uint64_t length)
+{
+    if (!entry)
+        return restinio_response_builder_file(rb, filepath, first, length);
+    retain_entry(entry);
+    restinio_response_builder_body_owned(rb, entry->data + first, (size_t)length, release_entry, entry);
+    return true;
+}
+
+// 206 (or 416) for a Range request on the identity representation; NULL
+// when the Range header does not apply and the full file should be sent.
+// Consumes the caller's entry reference only when it returns a response.
+static restinio_response_t *send_ranges(
+    const restinio_request_t *req, file_entry_t *entry,
+    const char *filepath, uint64_t size, const char *mime_type,
+    const char *etag, const char *last_modified, time_t modified, bool vary)
+{
+    const char *range = restinio_request_header(req, "Range", NULL);
+    if (!range || !if_range_matches(req, etag, modified))
+        return NULL;
+
+    restinio_byte_range_t ranges[RESTINIO_HTTP_MAX_RANGES];
+    int num_ranges = restinio_http_parse_ranges(range, size, ranges);
+    if (num_ranges < 0)
+        return NULL;
+
+    char content_range[80];
+    restinio_response_builder_t *rb = restinio_response_builder(num_ranges ? 206 : 416);
+    if (vary)
+        restinio_response_builder_header(rb, "Vary", "Accept-Encoding");
+    restinio_response_builder_header(rb, "Accept-Ranges", "bytes");
+    restinio_response_builder_header(rb, "ETag", etag);
+    restinio_response_builder_header(rb, "Last-Modified", last_modified);
+
+    bool ok = true;
+    if (!num_ranges) {
+        snprintf(content_range, sizeof(content_range), "bytes */%llu", (unsigned long long)size);
+        restinio_response_builder_header(rb, "Content-Range", content_range);
+    } else if (num_ranges == 1) {
+        snprintf(content_range, sizeof(content_range), "bytes %llu-%llu/%llu",
+                 (unsigned long long)ranges[0].first, (unsigned long long)ranges[0].last,
+                 (unsigned long long)size);
+        restinio_response_builder_header(rb, "Content-Type", mime_type);
+        restinio_response_builder_header(rb, "Content-Range", content_range);
+        ok = append_slice(rb, entry, filepath, ranges[0].first, ranges[0].last - ranges[0].first + 1);
     } else {
-        resp->response = NULL;
-        resp->response_length = 0;
+        static _Atomic uint64_t boundary_seq;
+        uint64_t seq = atomic_fetch_add(&boundary_seq, 1);
+        char boundary[40], content_type[80], part[256];
+        snprintf(boundary, sizeof(boundary), "restinio_%016llx",
+                 (unsigned long long)hash_bytes(&seq, sizeof(seq)) ^ (unsigned long long)time(NULL));
+        snprintf(content_type, sizeof(content_type), "multipart/byteranges; boundary=%s", boundary);
+        restinio_response_builder_header(rb, "Content-Type", content_type);
+
+        for (int i = 0; i < num_ranges && ok; i++) {
+            size_t n = restinio_http_range_part(part, sizeof(part), boundary, mime_type,
+                                                ranges + i, size, i == 0);
+            restinio_response_builder_body(rb, part, n);
+            ok = append_slice(rb, entry, filepath, ranges[i].first, ranges[i].last - ranges[i].first + 1);
+        }
+        size_t n = restinio_http_range_part(part, sizeof(part), boundary, NULL, NULL, size, false);
+        restinio_response_builder_body(rb, part, n);
     }
 
-    // Set the status code and error message
-    if (status_code >= 200 && status_code < 300) {
-        resp->error_code = 0;
+    if (entry)
+        release_entry(entry);
+    if (!ok) {
+        restinio_response_t *r = restinio_response_builder_finish(rb);
+        r->destroy(r);
+        return not_found();
+    }
+    return restinio_response_builder_finish(rb);
+}
+
+// Sends the bytes of filepath (or its cached gzip variant) as a
+// representation of the file whose stat is `original`, or a bodiless 304
+// when the request's validators match.  coding names the Content-Encoding of
+// a precompressed sibling; vary is set when the encoding was negotiated.
+// Range requests are honoured on the identity representation only.
+static restinio_response_t *send_file(
+    restinio_path_handler_t *handler, const restinio_request_t *req,
+    const char *filepath, const struct stat *st, const struct stat *original,
+    const char *mime_type, const char *coding, bool vary, bool gzip)
+{
+    char etag[64];
+    file_entry_t *entry = NULL;
+    size_t sendfile_min_bytes =
+        atomic_load_explicit(&handler->sendfile_min_bytes, memory_order_relaxed);
+    bool use_sendfile = sendfile_min_bytes && (size_t)st->st_size >= sendfile_min_bytes;
+
+    if (use_sendfile) {
+        // hashing would mean reading the whole file; size and mtime stand in
+        snprintf(etag, sizeof(etag), "\"%llx-%llx\"",
+                 (unsigned long long)st->st_size,
+                 (unsigned long long)st->st_mtim.tv_sec * 1000000000ull +
+                     (unsigned long long)st->st_mtim.tv_nsec);
     } else {
-        resp->error_code = status_code;
-        resp->error_message = strdup(status_message ? status_message : "");
+        entry = acquire_entry(&handler->cache, filepath, st);
+        if (!entry)
+            return not_found();
+        if (gzip && entry_gzip(&handler->cache, entry))
+            coding = "gzip";
+        else
+            gzip = false;
+        snprintf(etag, sizeof(etag), "\"%016llx%s\"",
+                 (unsigned long long)entry->content_hash, gzip ? "-gzip" : "");
     }
 
-    // Add a Content-Type header
-    restinio_header_t *header = (restinio_header_t *)calloc(1, sizeof(restinio_header_t));
-    if (header) {
-        header->key = strdup("Content-Type");
-        header->value = strdup(content_type ? content_type : "text/plain");
-        header->next = NULL;
-        resp->headers = header;
+    char last_modified[40];
+    restinio_http_format_date(original->st_mtim.tv_sec, last_modified, sizeof(last_modified));
+
+    if (not_modified(req, etag, original->st_mtim.tv_sec)) {
+        if (entry)
+            release_entry(entry);
+        restinio_response_builder_t *rb = restinio_response_builder(304);
+        restinio_response_builder_header(rb, "ETag", etag);
+        restinio_response_builder_header(rb, "Last-Modified", last_modified);
+        if (vary)
+            restinio_response_builder_header(rb, "Vary", "Accept-Encoding");
+        return restinio_response_builder_finish(rb);
+    }
+
+    if (req && !coding) {
+        // ranges must fall within the bytes actually held: the entry may have
+        // been loaded after the stat, from a file that has since changed size
+        uint64_t size = entry ? (uint64_t)entry->size : (uint64_t)st->st_size;
+        restinio_response_t *r = send_ranges(req, entry, filepath, size, mime_type,
+                                             etag, last_modified, original->st_mtim.tv_sec, vary);
+        if (r)
+            return r;
+    }
+
+    restinio_response_builder_t *rb = restinio_response_builder(200);
+    restinio_response_builder_header(rb, "Content-Type", mime_type);
+    if (coding)
+        restinio_response_builder_header(rb, "Content-Encoding", coding);
+    else if (req)
+        // the legacy callback cannot see a Range header
+        restinio_response_builder_header(rb, "Accept-Ranges", "bytes");
+    if (vary)
+        restinio_response_builder_header(rb, "Vary", "Accept-Encoding");
+    restinio_response_builder_header(rb, "ETag", etag);
+    restinio_response_builder_header(rb, "Last-Modified", last_modified);
+
+    if (use_sendfile) {
+        // Large files go straight from the page cache to the socket
+        if (!restinio_response_builder_file(rb, filepath, 0, (uint64_t)st->st_size)) {
+            restinio_response_t *r = restinio_response_builder_finish(rb);
+            r->destroy(r);
+            return not_found();
+        }
+    } else if (gzip) {
+        restinio_response_builder_body_owned(rb, entry->gzip_data, entry->gzip_size, release_entry, entry);
     } else {
-        fprintf(stderr, "Failed to allocate header\n");
+        restinio_response_builder_body_owned(rb, entry->data, entry->size, release_entry, entry);
+    }
+    return restinio_response_builder_finish(rb);
+}
+
+static restinio_response_t *serve_file(
+    restinio_path_handler_t *handler, const char *filepath, const restinio_request_t *req)
+{
+    struct stat st;
+    if (stat(filepath, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return not_found();
+    }
+
+    const char *mime_type = guess_mime_type(filepath);
+    if (!req || !compressible_mime_type(mime_type))
+        return send_file(handler, req, filepath, &st, &st, mime_type, NULL, false, false);
+
+    // byte ranges address the identity representation
+    if (restinio_request_header(req, "Range", NULL))
+        return send_file(handler, req, filepath, &st, &st, mime_type, NULL, true, false);
+
+    // Precompressed siblings (app.js.zst, app.js.gz) win, best ratio first
+    static const struct {
+        const char *coding;
+        const char *ext;
+    } siblings[] = { { "zstd", ".zst" }, { "gzip", ".gz" } };
+    for (size_t i = 0; i < sizeof(siblings) / sizeof(siblings[0]); i++) {
+        char variant[520];
+        struct stat variant_st;
+        if (restinio_request_accepts_encoding(req, siblings[i].coding) &&
+            find_sibling(filepath, siblings[i].ext, &st, variant, sizeof(variant), &variant_st))
+            return send_file(handler, req, variant, &variant_st, &st,
+                             mime_type, siblings[i].coding, true, false);
     }
 
-    return resp;
+    bool gzip = st.st_size >= GZIP_MIN_BYTES && restinio_request_accepts_encoding(req, "gzip");
+    return send_file(handler, req, filepath, &st, &st, mime_type, NULL, true, gzip);
+}
+
+//-----------------------------------------------------
+// Helper: create a restinio_response_t
+//-----------------------------------------------------
+static restinio_response_t *make_response(
+    const char *body, const char *content_type, int status_code, const char *status_message)
+{
+    (void)status_message;
+    restinio_response_builder_t *rb = restinio_response_builder(status_code);
+    restinio_response_builder_header(rb, "Content-Type", content_type ? content_type : "text/plain");
+    if (body)
+        restinio_response_builder_body(rb, body, strlen(body));
+    return restinio_response_builder_finish(rb);
 }
 
 //-----------------------------------------------------
@@ -191,27 +735,8 @@ static const char *guess_mime_type(const char *filename)
     if (len >= 4 && strcasecmp(filename + len - 4, ".json") == 0) {
         return "application/json";
     }
-    return "text/plain";
-}
-
-//-----------------------------------------------------
-// Helper: clean up a response
-//-----------------------------------------------------
-static void destroy_response(restinio_response_t *response)
-{
-    if (!response) return;
-
-    if (response->response) free(response->response);
-    if (response->error_message) free(response->error_message);
-
-    restinio_header_t *header = response->headers;
-    while (header) {
-        restinio_header_t *next = header->next;
-        free(header->key);
-        free(header->value);
-        free(header);
-        header = next;
+    if (len >= 4 && strcasecmp(filename + len - 4, ".svg") == 0) {
+        return "image/svg+xml";
     }
-
-    free(response);
+    return "text/plain";
 }
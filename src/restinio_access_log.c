@@ -0,0 +1,301 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#include "restinio_access_log.h"
+#include "restinio-c/restinio_c.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BATCH_BYTES (256 * 1024)
+#define MAX_IOV 64
+#define IDLE_SLEEP_NS (10 * 1000 * 1000)
+
+typedef struct ring_s {
+    _Alignas(64) atomic_size_t tail;    // written by the producer
+    _Alignas(64) atomic_size_t head;    // written by the writer thread
+    atomic_uint_fast64_t dropped;
+    const void *owner;                  // the producing thread's token
+    size_t mask;
+    restinio_access_entry_t *entries;
+    struct ring_s *next;
+} ring_t;
+
+struct restinio_access_log_s {
+    uint64_t id;
+    int fd;
+    int format;
+    size_t ring_entries;
+    _Atomic(ring_t *) rings;            // push-only list
+
+    pthread_t writer;
+    atomic_bool stopping;
+
+    char *buffer;                       // BATCH_BYTES of formatted lines
+};
+
+static atomic_uint_fast64_t next_log_id = 1;
+
+// The address of a thread-local is unique among live threads
+static _Thread_local char thread_token;
+static _Thread_local struct {
+    uint64_t log_id;
+    ring_t *ring;
+} cached;
+
+static ring_t *thread_ring(restinio_access_log_t *log) {
+    if (cached.log_id == log->id)
+        return cached.ring;
+
+    ring_t *ring;
+    for (ring = atomic_load(&log->rings); ring; ring = ring->next) {
+        if (ring->owner == &thread_token)
+            break;
+    }
+    if (!ring) {
+        ring = (ring_t *)aligned_alloc(_Alignof(ring_t), sizeof(ring_t));
+        restinio_access_entry_t *entries =
+            (restinio_access_entry_t *)malloc(log->ring_entries * sizeof(restinio_access_entry_t));
+        if (!ring || !entries) {
+            free(ring);
+            free(entries);
+            return NULL;
+        }
+        memset(ring, 0, sizeof(*ring));
+        ring->owner = &thread_token;
+        ring->mask = log->ring_entries - 1;
+        ring->entries = entries;
+        ring_t *head = atomic_load(&log->rings);
+        do {
+            ring->next = head;
+        } while (!atomic_compare_exchange_weak(&log->rings, &head, ring));
+    }
+    cached.log_id = log->id;
+    cached.ring = ring;
+    return ring;
+}
+
+void restinio_access_log_write(restinio_access_log_t *log, const restinio_access_entry_t *entry) {
+    ring_t *ring = thread_ring(log);
+    if (!ring)
+        return;
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) > ring->mask) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    restinio_access_entry_t *slot = &ring->entries[tail & ring->mask];
+    size_t fixed = offsetof(restinio_access_entry_t, target);
+    memcpy(slot, entry, fixed + entry->target_length);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+uint64_t restinio_access_log_dropped(restinio_access_log_t *log) {
+    uint64_t dropped = 0;
+    for (ring_t *ring = atomic_load(&log->rings); ring; ring = ring->next)
+        dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    return dropped;
+}
+
+// Returns the bytes written into out (at most size); 0 if it did not fit
+static size_t append(char *out, size_t size, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static size_t append(char *out, size_t size, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(out, size, fmt, args);
+    va_end(args);
+    return n < 0 || (size_t)n >= size ? 0 : (size_t)n;
+}
+
+// JSON string body: quotes, backslashes and control bytes escaped
+static size_t json_escape(char *out, size_t size, const char *s, size_t length) {
+    size_t n = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (n + 6 >= size)
+            return 0;
+        if (c == '"' || c == '\\') {
+            out[n++] = '\\';
+            out[n++] = (char)c;
+        } else if (c < 0x20) {
+            n += (size_t)snprintf(out + n, size - n, "\\u%04x", c);
+        } else {
+            out[n++] = (char)c;
+        }
+    }
+    return n;
+}
+
+static size_t format_entry(const restinio_access_log_t *log, const restinio_access_entry_t *e,
+                           char *out, size_t size) {
+    time_t seconds = (time_t)(e->time_us / 1000000);
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+
+    if (log->format == RESTINIO_ACCESS_LOG_JSON) {
+        char time_text[32];
+        strftime(time_text, sizeof(time_text), "%Y-%m-%dT%H:%M:%S", &tm);
+        size_t n = append(out, size,
+                          "{\"time\":\"%s.%06uZ\",\"connection\":%llu,\"method\":\"%s\",\"target\":\"",
+                          time_text, (unsigned)(e->time_us % 1000000),
+                          (unsigned long long)e->connection_id, e->method);
+        if (!n)
+            return 0;
+        size_t escaped = json_escape(out + n, size - n, e->target, e->target_length);
+        if (!escaped && e->target_length)
+            return 0;
+        n += escaped;
+        size_t tail = append(out + n, size - n,
+                             "\",\"status\":%u,\"bytes_in\":%llu,\"bytes_out\":%llu,"
+                             "\"queue_us\":%u,\"handler_us\":%u,\"total_us\":%u}\n",
+                             e->status, (unsigned long long)e->bytes_in,
+                             (unsigned long long)e->bytes_out,
+                             e->queue_us, e->handler_us, e->total_us);
+        return tail ? n + tail : 0;
+    }
+
+    // Common Log Format (no client address or user), timings appended
+    char time_text[40];
+    strftime(time_text, sizeof(time_text), "%d/%b/%Y:%H:%M:%S +0000", &tm);
+    return append(out, size,
+                  "- - - [%s] \"%s %.*s HTTP/%u.%u\" %u %llu conn=%llu queue_us=%u handler_us=%u total_us=%u\n",
+                  time_text, e->method, (int)e->target_length, e->target,
+                  e->http_major, e->http_minor, e->status,
+                  (unsigned long long)e->bytes_out, (unsigned long long)e->connection_id,
+                  e->queue_us, e->handler_us, e->total_us);
+}
+
+static void write_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0)
+            return;     // nowhere to report it; the entries are lost
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+}
+
+// One pass over every ring: each ring's entries become one iovec, and the
+// batch is written whenever the buffer or the iovec array fills up.
+// Returns the number of entries written.
+static size_t drain(restinio_access_log_t *log) {
+    struct iovec iov[MAX_IOV];
+    int count = 0;
+    size_t used = 0, written = 0;
+
+    for (ring_t *ring = atomic_load(&log->rings); ring; ring = ring->next) {
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        size_t start = used;
+        while (head != tail) {
+            size_t n = format_entry(log, &ring->entries[head & ring->mask],
+                                    log->buffer + used, BATCH_BYTES - used);
+            if (n) {
+                used += n;
+                head++;
+                written++;
+                continue;
+            }
+            if (used == 0) {
+                head++;     // cannot be formatted even into an empty buffer
+                continue;
+            }
+            if (used > start) {
+                iov[count].iov_base = log->buffer + start;
+                iov[count].iov_len = used - start;
+                count++;
+            }
+            write_all(log->fd, iov, count);
+            count = 0;
+            used = start = 0;
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+        if (used > start) {
+            iov[count].iov_base = log->buffer + start;
+            iov[count].iov_len = used - start;
+            count++;
+        }
+        if (count == MAX_IOV) {
+            write_all(log->fd, iov, count);
+            count = 0;
+            used = 0;
+        }
+    }
+    if (count)
+        write_all(log->fd, iov, count);
+    return written;
+}
+
+static void *writer_main(void *arg) {
+    restinio_access_log_t *log = (restinio_access_log_t *)arg;
+    const struct timespec idle = { 0, IDLE_SLEEP_NS };
+    while (!atomic_load(&log->stopping)) {
+        if (!drain(log))
+            nanosleep(&idle, NULL);
+    }
+    while (drain(log))
+        ;
+    return NULL;
+}
+
+restinio_access_log_t *restinio_access_log_open(const char *path,
+                                                int format,
+                                                size_t ring_entries) {
+    restinio_access_log_t *log = (restinio_access_log_t *)calloc(1, sizeof(*log));
+    if (!log)
+        return NULL;
+    size_t entries = 1;
+    while (entries < (ring_entries ? ring_entries : 1024))
+        entries <<= 1;
+    log->id = atomic_fetch_add(&next_log_id, 1);
+    log->format = format;
+    log->ring_entries = entries;
+    log->buffer = (char *)malloc(BATCH_BYTES);
+    log->fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (!log->buffer || log->fd < 0 ||
+        pthread_create(&log->writer, NULL, writer_main, log) != 0) {
+        if (log->fd >= 0)
+            close(log->fd);
+        free(log->buffer);
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+void restinio_access_log_close(restinio_access_log_t *log) {
+    if (!log)
+        return;
+    atomic_store(&log->stopping, true);
+    pthread_join(log->writer, NULL);
+    close(log->fd);
+
+    ring_t *ring = atomic_load(&log->rings);
+    while (ring) {
+        ring_t *next = ring->next;
+        free(ring->entries);
+        free(ring);
+        ring = next;
+    }
+    free(log->buffer);
+    free(log);
+}
@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef _RESTINIO_ACCESS_LOG_H
+#define _RESTINIO_ACCESS_LOG_H
+
+/*
+ * Internal: asynchronous access log.
+ *
+ * Each thread that logs gets its own single-producer ring on first use; a
+ * thread that reuses the slot of one that exited adopts its ring.  Writing
+ * an entry is a bounded copy and a release store, and an entry that finds
+ * the ring full is counted as dropped instead of waiting.  A background
+ * thread drains every ring, formats the entries and writes each pass with
+ * one writev.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RESTINIO_ACCESS_LOG_TARGET_MAX 238
+
+typedef struct {
+    uint64_t time_us;           // wall clock, microseconds since the epoch
+    uint64_t connection_id;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint32_t queue_us;
+    uint32_t handler_us;
+    uint32_t total_us;
+    uint16_t status;
+    uint8_t http_major, http_minor;
+    char method[16];
+    uint16_t target_length;     // truncated to RESTINIO_ACCESS_LOG_TARGET_MAX
+    char target[RESTINIO_ACCESS_LOG_TARGET_MAX];
+} restinio_access_entry_t;
+
+typedef struct restinio_access_log_s restinio_access_log_t;
+
+// format is a restinio_access_log_format_t; ring_entries is per thread and
+// rounded up to a power of two.  NULL if the file cannot be opened.
+restinio_access_log_t *restinio_access_log_open(const char *path,
+                                                int format,
+                                                size_t ring_entries);
+
+// Writes whatever is still queued, then stops the writer and closes the file
+void restinio_access_log_close(restinio_access_log_t *log);
+
+// Never blocks; the entry is dropped if this thread's ring is full
+void restinio_access_log_write(restinio_access_log_t *log, const restinio_access_entry_t *entry);
+
+uint64_t restinio_access_log_dropped(restinio_access_log_t *log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -3,7 +3,17 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "restinio-c/restinio_c.h"
+#include "restinio_route_table.h"
+#include "restinio_worker_pool.h"
+#include "restinio_metrics.h"
+#include "restinio_access_log.h"
+#include "restinio_response_cache.h"
+#include "restinio_http.h"
 #include <restinio/all.hpp>  // for restinio::run, on_thread_pool, create_response, etc.
+#include <restinio/transforms/zlib.hpp>
+#include <restinio/tls.hpp>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
 #include <thread>
 #include <memory>
 #include <atomic>
@@ -13,167 +23,2175 @@
 #include <mutex>
 #include <map>
 #include <unordered_map>
+#include <vector>
+#include <optional>
+#include <type_traits>
+#include <condition_variable>
+#include <algorithm>
+#include <cstddef>
+#include <pthread.h>
+#include <sched.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
 
 
+// A constant response registered with restinio_use_static(), serialized
+// once.  The body is sent in place; the route outlives every connection.
+struct static_response_t {
+    restinio::http_status_line_t status_line;
+    int status_code;
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+    std::string etag;           // sent with 2xx responses, empty otherwise
+};
+
+// A registered route.  Handlers are kept in registration order and frozen
+// into the route table by restinio_server_run().
+struct restinio_route_s {
+    char *method;
+    char *path;
+    restinio_handle_detached_request_cb detached_cb;
+    restinio_handle_request_cb cb;
+    restinio_handle_detached_request_view_cb detached_view_cb;
+    restinio_handle_request_view_cb view_cb;
+    void *arg;
+
+    size_t compress_min_bytes;  // 0 unless restinio_route_compress() was called
+    bool blocking;              // runs on the server's worker pool
+    size_t max_body_size;       // 0 for no limit of its own
+    restinio_body_chunk_cb body_chunk_cb;
+    uint32_t deadline_ms;       // detached requests get a 504 after this
+    restinio_cancel_cb cancel_cb;
+    static_response_t *static_response;
+    restinio_response_cache_t *cache;   // restinio_route_cache()
+    char *cache_vary;           // header names, each NUL-terminated, then ""
+
+    restinio_server_t *server;  // set with index when the routes are frozen
+    uint32_t index;
+
+    struct restinio_route_s *next;
+};
+
+// Told when connections close, so detached requests still pending on them
+// can be cancelled
+struct restinio_c_connection_listener_t {
+    restinio_server_t *server;
+
+    void state_changed(const restinio::connection_state::notice_t &notice) noexcept;
+};
+
+// Connection counting is compiled into Restinio only when the traits ask for
+// it; max_parallel_connections() is then honoured by the acceptor.
+struct restinio_c_traits_t : public restinio::default_traits_t {
+    static constexpr bool use_connection_count_limiter = true;
+    using connection_state_listener_t = restinio_c_connection_listener_t;
+};
+
+// Same, over TLS
+struct restinio_c_tls_traits_t
+    : public restinio::tls_traits_t<restinio::asio_timer_manager_t, restinio::null_logger_t> {
+    static constexpr bool use_connection_count_limiter = true;
+    using connection_state_listener_t = restinio_c_connection_listener_t;
+};
+
+// Detached responses finished off the I/O threads wait here (an intrusive
+// lock-free stack of handles) and the first one in posts a single task
+// that sends everything queued by the time it runs.  One per io_context,
+// owned by the server so handles finished after a stop still find it;
+// closed while its io_context is not running, when nothing posted to it
+// would run and completions are sent by the thread that finishes them.
+struct restinio_completion_queue_t {
+    std::atomic<restinio::asio_ns::io_context *> io_context{nullptr};
+    std::atomic<restinio_request_t *> head{nullptr};
+    std::atomic<bool> closed{true};
+};
+
+// One listener of a sharded server: a single-threaded io_context pinned to a
+// CPU, bound with SO_REUSEPORT alongside the others.
+struct restinio_shard_t {
+    restinio::asio_ns::io_context io_context;
+    restinio_completion_queue_t *completions;   // server->shard_completions
+    std::unique_ptr<restinio::http_server_t<restinio_c_traits_t>> server;
+    std::unique_ptr<restinio::http_server_t<restinio_c_tls_traits_t>> tls_server;
+    std::thread thread;
+};
+
+// A listener with its own routes and thread pool.  restinio_init, _use, _run
+// and _destroy drive a default instance.
+struct restinio_server_s {
+    restinio_options_t options;
+    std::string address;        // options.address points here
+    std::string cert_file, key_file;  // as do these, so they can be reloaded
+    std::string access_log_path;
+
+    restinio_route_t *routes_head, *routes_tail;
+
+    // Frozen by restinio_server_run(): routes[i] is the i-th registered
+    // handler and route_table maps (method, target) to indices into routes.
+    std::vector<restinio_route_t *> routes;
+    restinio_route_table_t *route_table;
+
+    // Body limit Restinio enforces while reading: options.max_body_size, or
+    // the largest route limit when every route has one (0 for none)
+    size_t read_body_limit;
+
+    // Kept until destroy (or the next run) even once stopped, since detached
+    // requests still reference its io_context.
+    std::unique_ptr<restinio::asio_ns::io_context> io_context;  // the pool's
+    restinio_completion_queue_t completions;
+    restinio::running_server_handle_t<restinio_c_traits_t> running;
+    restinio::running_server_handle_t<restinio_c_tls_traits_t> running_tls;
+    std::vector<std::unique_ptr<restinio_shard_t>> shards;  // options.shards > 0
+    // one per shard, reused by every run
+    std::vector<std::unique_ptr<restinio_completion_queue_t>> shard_completions;
+    bool stopped;
+
+    // Created on the first run when a route is marked blocking
+    restinio_worker_pool_t *workers;
+
+    // With enable_ssl: the context Restinio runs on (it owns the session
+    // cache and ticket keys) and the certificate handshakes are switched to,
+    // replaced by restinio_server_reload_tls().
+    std::shared_ptr<restinio::asio_ns::ssl::context> tls;
+    std::mutex tls_mutex;
+    SSL_CTX *tls_certificate;
+
+    // With enable_metrics: per-route slots, created when the routes are
+    // frozen, and the rare outcomes that have no route.
+    restinio_metrics_t *metrics;
+    std::atomic<uint64_t> unrouted{0};
+    std::atomic<uint64_t> rejected_overload{0};
+    std::atomic<uint64_t> rejected_draining{0};
+
+    // With access_log_path: opened on the first run
+    restinio_access_log_t *access_log;
+
+    // Requests accepted and not yet answered; detached ones are counted in
+    // both.  While draining, new requests get a 503 and every response
+    // closes its connection.
+    std::atomic<size_t> in_flight{0};
+    std::atomic<size_t> detached{0};
+    std::atomic<bool> draining{false};
+    std::mutex drain_mutex;
+    std::condition_variable drained;
+
+    // Detached requests not yet finished, in intrusive lists striped by
+    // connection id, so a closed connection can cancel its own
+    struct detached_stripe_t {
+        std::mutex mutex;
+        restinio_request_t *head = nullptr;
+    };
+    static constexpr size_t detached_stripes = 16;
+    detached_stripe_t pending[detached_stripes];
+};
+
+// How a detached handle ends and what still references it: its owner
+// until it is finished, plus a pending deadline timer or a cancellation in
+// progress.  A copied view starts a fresh handle.
+enum { handle_pending, handle_finished, handle_cancelled };
+
+struct handle_state_t {
+    std::atomic<int> outcome{handle_pending};
+    std::atomic<int> refs{1};
+    restinio::asio_ns::steady_timer *deadline = nullptr;
+
+    // links in the server's list of detached requests for the connection's
+    // stripe, while registered
+    restinio_request_t *prev = nullptr, *next = nullptr;
+    bool registered = false;
+
+    handle_state_t() = default;
+    handle_state_t(const handle_state_t &) {}
+    handle_state_t &operator=(const handle_state_t &) {
+        outcome.store(handle_pending, std::memory_order_relaxed);
+        refs.store(1, std::memory_order_relaxed);
+        deadline = nullptr;
+        prev = next = nullptr;
+        registered = false;
+        return *this;
+    }
+};
+
+// Query parameters, parsed lazily by the restinio_request_query* accessors.
+// Parsed parameters cannot be copied, so a copied view (a detached handle)
+// starts out unparsed.
+struct lazy_query_t {
+    mutable std::optional<restinio::query_string_params_t> params;
+
+    lazy_query_t() = default;
+    lazy_query_t(const lazy_query_t &) {}
+    lazy_query_t &operator=(const lazy_query_t &) {
+        params.reset();
+        return *this;
+    }
+};
+
+// The request view handed to callbacks.  Synchronous views live on the
+// dispatcher's stack; detached ones are heap allocated and double as the
+// response handle, so the request (and every slice into it) stays alive
+// until restinio_finish_detached*.
+struct restinio_request_s {
+    restinio::request_handle_t req;
+
+    // {name} segments captured by the matching route
+    restinio_route_param_t params[RESTINIO_ROUTE_MAX_PARAMS];
+    size_t num_params;
+
+    lazy_query_t query;
+
+    // the route that accepted the request
+    const restinio_route_t *route;
+    restinio_server_t *server;
+
+    // Microsecond timestamps for metrics and the access log, 0 when both
+    // are off (or the handler has not returned yet)
+    uint64_t received_us;
+    uint64_t handler_start_us;
+    uint64_t handler_end_us;
+
+    // Detached handles: the queue of the io_context the request came in
+    // on, and while queued there, the prepared response
+    restinio_completion_queue_t *completions;
+    restinio_response_t *completion;
+    bool completion_vary;
+    restinio_request_t *next_completion;
+    bool detached;              // counted in server->detached
+    handle_state_t state;
+
+    // set while this request leads a miss on its route's cache
+    restinio_cache_pending_t *cache_pending;
+};
+
+// Pooled response builder.  `response` must stay the first member: the
+// restinio_response_t handed back by restinio_response_builder_finish() is
+// the builder itself, which is how send_response() recognises it and sends
+// the body straight from the builder's buffer.
+struct restinio_response_builder_s {
+    restinio_response_t response;
+    int status_code;
+
+    struct header_ref_t {
+        size_t key, key_length;
+        size_t value, value_length;
+    };
+
+    // The body is a sequence of pieces: runs of `body` appended through
+    // restinio_response_builder_body(), caller-owned buffers that are
+    // released once written and file slices sent with sendfile.
+    struct body_item_t {
+        const char *data;           // NULL for a run of `body` or a file
+        size_t offset, length;      // offset into `body` (unused for files)
+        restinio_release_cb release;
+        void *release_arg;
+        int file;                   // index into files, -1 otherwise
+    };
+
+    std::string body;
+    std::vector<body_item_t> items;
+    std::vector<restinio::sendfile_t> files;
+    std::string header_data;                 // key\0value\0 pairs
+    std::vector<header_ref_t> header_refs;   // offsets into header_data
+    std::vector<restinio_header_t> header_nodes; // restinio_response_t view
+    bool etag_from_body;         // restinio_response_builder_etag(rb, NULL)
+};
+
+// Streaming (chunked) response.  The counters live in a shared state so
+// flush notifications that arrive after restinio_stream_finish() stay safe.
+struct restinio_stream_s {
+    struct state_t {
+        std::atomic<size_t> pending{0};     // appended, not yet written
+        std::atomic<bool> paused{false};
+        std::atomic<bool> failed{false};
+        size_t high_watermark = 0;
+        restinio_stream_drain_cb on_drain = nullptr;
+        void *drain_arg = nullptr;
+    };
+
+    explicit restinio_stream_s(
+        restinio::response_builder_t<restinio::chunked_output_t> builder)
+        : rb(std::move(builder)), state(std::make_shared<state_t>()) {}
+
+    restinio::response_builder_t<restinio::chunked_output_t> rb;
+    std::shared_ptr<state_t> state;
+    restinio_server_t *server = nullptr;    // counts the stream as in flight
+    size_t unflushed = 0;                   // appended since the last flush
+    std::vector<std::pair<restinio_release_cb, void *>> releases;
+};
+
 // Anonymous namespace
 namespace {
 
-typedef struct restinio_path_handler_s {
-    char *method;
-    char *path;
-    restinio_handle_detached_request_cb detached_cb;
-    restinio_handle_request_cb cb;
-    void *arg;
+restinio_server_t *g_default_server = NULL;
+bool g_default_initialized = false;
+
+/**
+ * 1) Instead of a single signature that takes a `response_builder_t<default_traits_t> &`,
+ *    we make apply_headers_from_user a template, so it can accept *any* of the modern
+ *    `response_builder_t<Traits>` types that Restinio might produce.
+ *
+ * 2) We replace `rb.append_header(...)` with `rb.header().set_field(...)`, which is
+ *    the typical modern approach in new versions of Restinio.
+ */
+template<typename Builder>
+void apply_headers_from_user(Builder &rb, restinio_header_t *hdr_list)
+{
+    for (auto *hdr = hdr_list; hdr != nullptr; hdr = hdr->next) {
+        if (hdr->key && hdr->value) {
+            // Old code: rb.append_header(hdr->key, hdr->value);
+            // Modern code:
+            rb.header().set_field(hdr->key, hdr->value);
+        }
+    }
+}
+
+// Builders are recycled through a small per-thread free list.  A builder is
+// usually released on the I/O thread that wrote it, which is also where the
+// next request on that connection will pick one up.
+constexpr size_t builder_pool_limit = 64;
+constexpr size_t builder_retain_limit = 64 * 1024; // larger bodies are freed
+
+struct builder_pool_t {
+    std::vector<restinio_response_builder_t *> free_list;
+    ~builder_pool_t();
+};
+
+thread_local bool t_builder_pool_gone = false;
+thread_local builder_pool_t t_builder_pool;
+
+builder_pool_t::~builder_pool_t() {
+    for (auto *b : free_list)
+        delete b;
+    t_builder_pool_gone = true;
+}
+
+restinio_response_builder_t *acquire_response_builder() {
+    if (!t_builder_pool_gone && !t_builder_pool.free_list.empty()) {
+        restinio_response_builder_t *b = t_builder_pool.free_list.back();
+        t_builder_pool.free_list.pop_back();
+        return b;
+    }
+    return new restinio_response_builder_t();
+}
+
+void release_response_builder(restinio_response_t *r) {
+    auto *b = reinterpret_cast<restinio_response_builder_t *>(r);
+    for (const auto &item : b->items) {
+        if (item.release)
+            item.release(item.release_arg);
+    }
+    b->items.clear();
+    b->files.clear();
+    b->etag_from_body = false;
+
+    if (t_builder_pool_gone ||
+        t_builder_pool.free_list.size() >= builder_pool_limit ||
+        b->body.capacity() > builder_retain_limit) {
+        delete b;
+        return;
+    }
+    b->body.clear();
+    b->header_data.clear();
+    b->header_refs.clear();
+    b->header_nodes.clear();
+    t_builder_pool.free_list.push_back(b);
+}
+
+// Detached and blocking handles are recycled the same way.  Queued
+// completions release them on the I/O thread that allocated them.
+constexpr size_t handle_pool_limit = 256;
+
+struct handle_pool_t {
+    std::vector<restinio_request_t *> free_list;
+    ~handle_pool_t();
+};
+
+thread_local bool t_handle_pool_gone = false;
+thread_local handle_pool_t t_handle_pool;
+
+handle_pool_t::~handle_pool_t() {
+    for (auto *h : free_list)
+        delete h;
+    t_handle_pool_gone = true;
+}
+
+restinio_request_t *acquire_handle(const restinio_request_t &view) {
+    if (!t_handle_pool_gone && !t_handle_pool.free_list.empty()) {
+        restinio_request_t *h = t_handle_pool.free_list.back();
+        t_handle_pool.free_list.pop_back();
+        *h = view;
+        return h;
+    }
+    return new restinio_request_t(view);
+}
+
+// Drops one reference; the last one recycles the handle
+void release_handle(restinio_request_t *h) {
+    if (h->state.refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    delete h->state.deadline;
+    h->state.deadline = nullptr;
+    if (t_handle_pool_gone || t_handle_pool.free_list.size() >= handle_pool_limit) {
+        delete h;
+        return;
+    }
+    h->req.reset();
+    h->query.params.reset();
+    t_handle_pool.free_list.push_back(h);
+}
+
+restinio::http_status_line_t status_line(int status_code) {
+    const char *reason;
+    switch (status_code) {
+    case 200: reason = "OK"; break;
+    case 201: reason = "Created"; break;
+    case 202: reason = "Accepted"; break;
+    case 204: reason = "No Content"; break;
+    case 206: reason = "Partial Content"; break;
+    case 301: reason = "Moved Permanently"; break;
+    case 302: reason = "Found"; break;
+    case 304: reason = "Not Modified"; break;
+    case 400: reason = "Bad Request"; break;
+    case 401: reason = "Unauthorized"; break;
+    case 403: reason = "Forbidden"; break;
+    case 404: reason = "Not Found"; break;
+    case 405: reason = "Method Not Allowed"; break;
+    case 408: reason = "Request Timeout"; break;
+    case 413: reason = "Payload Too Large"; break;
+    case 416: reason = "Range Not Satisfiable"; break;
+    case 500: reason = "Internal Server Error"; break;
+    case 501: reason = "Not Implemented"; break;
+    case 503: reason = "Service Unavailable"; break;
+    case 504: reason = "Gateway Timeout"; break;
+    default: reason = "Unknown"; break;
+    }
+    return restinio::http_status_line_t{
+        restinio::http_status_code_t{static_cast<std::uint16_t>(status_code)}, reason};
+}
+
+template<typename Builder>
+void apply_builder_headers(Builder &rb, const restinio_response_builder_t *b) {
+    for (const auto &h : b->header_refs) {
+        rb.append_header(
+            std::string(b->header_data.data() + h.key, h.key_length),
+            std::string(b->header_data.data() + h.value, h.value_length));
+    }
+}
+
+restinio::writable_item_t builder_item(
+    restinio_response_builder_t *b,
+    const restinio_response_builder_t::body_item_t &item) {
+    if (item.file >= 0)
+        return std::move(b->files[item.file]);
+    const char *data = item.data ? item.data : b->body.data() + item.offset;
+    return restinio::const_buffer(data, item.length);
+}
+
+restinio::request_handling_status_t send_builder_response(
+    const restinio::request_handle_t &req,
+    restinio_response_builder_t *b,
+    bool close) {
+    // Written straight from the builder (and any caller-owned buffers),
+    // which is released once Restinio reports the write finished or the
+    // connection went away.
+    auto release = [b](const restinio::asio_ns::error_code &) {
+        release_response_builder(&b->response);
+    };
+
+    if (b->items.size() <= 1) {
+        auto rb = req->create_response(status_line(b->status_code));
+        apply_builder_headers(rb, b);
+        if (close)
+            rb.connection_close();
+        if (!b->items.empty())
+            rb.set_body(builder_item(b, b->items[0]));
+        return rb.done(std::move(release));
+    }
+
+    size_t content_length = 0;
+    for (const auto &item : b->items)
+        content_length += item.length;
+
+    auto rb = req->create_response<restinio::user_controlled_output_t>(status_line(b->status_code));
+    apply_builder_headers(rb, b);
+    if (close)
+        rb.connection_close();
+    rb.set_content_length(content_length);
+    for (const auto &item : b->items)
+        rb.append_body(builder_item(b, item));
+    return rb.done(std::move(release));
+}
+
+bool compressible_type(const char *type, size_t length) {
+    restinio::string_view_t t{type, length};
+    auto starts = [&t](restinio::string_view_t prefix) {
+        return t.size() >= prefix.size() &&
+               !strncasecmp(t.data(), prefix.data(), prefix.size());
+    };
+    return starts("text/") || starts("application/json") ||
+           starts("application/javascript") || starts("application/xml") ||
+           starts("image/svg+xml") || t.find("+json") != restinio::string_view_t::npos ||
+           t.find("+xml") != restinio::string_view_t::npos;
+}
+
+bool header_is(restinio::string_view_t key, const char *name) {
+    size_t length = strlen(name);
+    return key.size() == length && !strncasecmp(key.data(), name, length);
+}
+
+// Calls f(key, value) for each header of a builder or plain response
+template<typename F>
+void each_header(const restinio_response_t *resp, F &&f) {
+    if (resp->destroy == release_response_builder) {
+        auto *b = reinterpret_cast<const restinio_response_builder_t *>(resp);
+        for (const auto &h : b->header_refs)
+            f(restinio::string_view_t{b->header_data.data() + h.key, h.key_length},
+              restinio::string_view_t{b->header_data.data() + h.value, h.value_length});
+        return;
+    }
+    for (auto *hdr = resp->headers; hdr; hdr = hdr->next) {
+        if (hdr->key && hdr->value)
+            f(restinio::string_view_t{hdr->key}, restinio::string_view_t{hdr->value});
+    }
+}
+
+std::optional<restinio::string_view_t> find_header(const restinio_response_t *resp, const char *name) {
+    std::optional<restinio::string_view_t> found;
+    each_header(resp, [&](restinio::string_view_t key, restinio::string_view_t value) {
+        if (!found && header_is(key, name))
+            found = value;
+    });
+    return found;
+}
+
+// "abc" -> "abc-gzip", W/"abc" -> W/"abc-gzip"
+std::string gzip_etag(restinio::string_view_t etag) {
+    std::string tag(etag);
+    if (!tag.empty() && tag.back() == '"')
+        tag.insert(tag.size() - 1, "-gzip");
+    else
+        tag += "-gzip";
+    return tag;
+}
+
+// If-None-Match uses the weak comparison, see restinio_http_etag_matches()
+bool if_none_match(restinio::string_view_t header, restinio::string_view_t etag) {
+    return restinio_http_etag_matches(header.data(), header.size(), etag.data(), etag.size());
+}
+
+const std::string *request_field(const restinio_request_t *view, const char *name) {
+    return view->req->header().try_get_field(restinio::string_view_t{name, strlen(name)});
+}
+
+// 304 is only an answer to GET and HEAD (RFC 9110 13.1.2); other methods
+// are processed as usual
+bool conditional_method(const restinio_request_t *view) {
+    auto method = view->req->header().method();
+    return method == restinio::http_method_get() || method == restinio::http_method_head();
+}
+
+// A 200 response to GET or HEAD whose ETag matches If-None-Match is replaced
+// by a bodiless 304 carrying the validator and caching headers (RFC 9110
+// 15.4.5).  On a compressing route the gzip variant's tag matches too.
+restinio_response_t *not_modified_response(
+    const restinio_request_t *view,
+    restinio_response_t *resp) {
+    if (!conditional_method(view))
+        return resp;
+    int status_code = resp->destroy == release_response_builder
+        ? reinterpret_cast<restinio_response_builder_t *>(resp)->status_code
+        : (resp->error_code ? 500 : 200);
+    if (status_code != 200)
+        return resp;
+
+    const std::string *condition = request_field(view, "If-None-Match");
+    if (!condition)
+        return resp;
+    auto etag = find_header(resp, "ETag");
+    if (!etag)
+        return resp;
+    bool compressing = view->route && view->route->compress_min_bytes;
+    if (!if_none_match(*condition, *etag) &&
+        !(compressing && if_none_match(*condition, gzip_etag(*etag))))
+        return resp;
+
+    restinio_response_builder_t *nb = acquire_response_builder();
+    nb->status_code = 304;
+    each_header(resp, [nb](restinio::string_view_t key, restinio::string_view_t value) {
+        if (header_is(key, "ETag") || header_is(key, "Last-Modified") ||
+            header_is(key, "Cache-Control") || header_is(key, "Expires") ||
+            header_is(key, "Vary") || header_is(key, "Content-Location"))
+            restinio_response_builder_header_n(nb, key.data(), key.size(), value.data(), value.size());
+    });
+    if (compressing && !find_header(resp, "Vary"))
+        restinio_response_builder_header_n(nb, "Vary", 4, "Accept-Encoding", 15);
+
+    if (resp->destroy)
+        resp->destroy(resp);
+    return restinio_response_builder_finish(nb);
+}
+
+// Dynamic gzip for routes that opted in with restinio_route_compress().
+// Successful in-memory bodies of a compressible type are compressed when the
+// client accepts gzip; the original response is released and a builder
+// carrying the compressed body takes its place.  *vary is set when the
+// response depends on Accept-Encoding but could not carry the header itself.
+restinio_response_t *compress_response(
+    const restinio_request_t *view,
+    restinio_response_t *resp,
+    bool *vary) {
+    size_t min_bytes = view->route->compress_min_bytes;
+    restinio_response_builder_t *b = resp->destroy == release_response_builder
+        ? reinterpret_cast<restinio_response_builder_t *>(resp)
+        : nullptr;
+
+    int status_code = b ? b->status_code : (resp->error_code ? 500 : 200);
+    if (status_code < 200 || status_code >= 300 || status_code == 204 || status_code == 206)
+        return resp;
+
+    // already encoded bodies are left alone
+    if (find_header(resp, "Content-Encoding"))
+        return resp;
+    auto content_type = find_header(resp, "Content-Type");
+    if (content_type && !compressible_type(content_type->data(), content_type->size()))
+        return resp;
+
+    // gather the body; file slices are never compressed on the fly
+    std::string gathered;
+    restinio::string_view_t body;
+    if (b) {
+        for (const auto &item : b->items) {
+            if (item.file >= 0)
+                return resp;
+        }
+        if (b->items.size() == 1) {
+            const auto &item = b->items[0];
+            body = restinio::string_view_t{
+                item.data ? item.data : b->body.data() + item.offset, item.length};
+        } else {
+            for (const auto &item : b->items)
+                gathered.append(item.data ? item.data : b->body.data() + item.offset, item.length);
+            body = gathered;
+        }
+    } else {
+        size_t length = resp->response_length;
+        if (!length && resp->response)
+            length = strlen(resp->response);
+        body = restinio::string_view_t{resp->response ? resp->response : "", length};
+    }
+    if (body.size() < min_bytes)
+        return resp;
+
+    const std::string *accept = request_field(view, "Accept-Encoding");
+    if (!accept || !restinio_http_accepts_encoding(accept->data(), accept->size(), "gzip")) {
+        if (b)
+            restinio_response_builder_header_n(b, "Vary", 4, "Accept-Encoding", 15);
+        else
+            *vary = true;
+        return resp;
+    }
+
+    std::string compressed;
+    try {
+        compressed = restinio::transforms::zlib::gzip_compress(body);
+    } catch (const std::exception &) {
+        return resp;
+    }
+
+    restinio_response_builder_t *nb = acquire_response_builder();
+    nb->status_code = status_code;
+    each_header(resp, [nb](restinio::string_view_t key, restinio::string_view_t value) {
+        if (header_is(key, "Content-Length"))
+            return;
+        if (header_is(key, "ETag")) {
+            // the encoded representation needs a tag of its own
+            std::string tag = gzip_etag(value);
+            restinio_response_builder_header_n(nb, key.data(), key.size(), tag.data(), tag.size());
+            return;
+        }
+        restinio_response_builder_header_n(nb, key.data(), key.size(), value.data(), value.size());
+    });
+    restinio_response_builder_header_n(nb, "Content-Encoding", 16, "gzip", 4);
+    restinio_response_builder_header_n(nb, "Vary", 4, "Accept-Encoding", 15);
+    restinio_response_builder_body(nb, compressed.data(), compressed.size());
+
+    if (resp->destroy)
+        resp->destroy(resp);
+    return restinio_response_builder_finish(nb);
+}
+
+uint64_t now_us() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint32_t clamp_us(uint64_t us) {
+    return us > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(us);
+}
+
+void log_access(restinio_server_t *server,
+                const restinio::request_handle_t &req,
+                int status,
+                uint64_t bytes_out,
+                uint64_t queue_us,
+                uint64_t handler_us,
+                uint64_t total_us) {
+    restinio_access_entry_t entry;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    entry.time_us = static_cast<uint64_t>(ts.tv_sec) * 1000000 +
+                    static_cast<uint64_t>(ts.tv_nsec) / 1000;
+    entry.connection_id = req->connection_id();
+    entry.bytes_in = req->body().size();
+    entry.bytes_out = bytes_out;
+    entry.queue_us = clamp_us(queue_us);
+    entry.handler_us = clamp_us(handler_us);
+    entry.total_us = clamp_us(total_us);
+    entry.status = static_cast<uint16_t>(status);
+    entry.http_major = static_cast<uint8_t>(req->header().http_major());
+    entry.http_minor = static_cast<uint8_t>(req->header().http_minor());
+    const char *method = req->header().method().c_str();
+    size_t method_length = std::min(strlen(method), sizeof(entry.method) - 1);
+    memcpy(entry.method, method, method_length);
+    entry.method[method_length] = 0;
+    const std::string &target = req->header().request_target();
+    entry.target_length = static_cast<uint16_t>(
+        std::min<size_t>(target.size(), RESTINIO_ACCESS_LOG_TARGET_MAX));
+    memcpy(entry.target, target.data(), entry.target_length);
+    restinio_access_log_write(server->access_log, &entry);
+}
+
+void record_metrics(const restinio_request_t *view, int status, uint64_t bytes_out) {
+    restinio_server_t *server = view->server;
+    if (!server || !view->received_us)
+        return;
+    uint64_t now = now_us();
+    uint64_t start = view->handler_start_us ? view->handler_start_us : now;
+    uint64_t end = view->handler_end_us ? view->handler_end_us : now;
+    if (server->metrics && view->route)
+        restinio_metrics_record(server->metrics, view->route->index, status,
+                                view->req->body().size(), bytes_out,
+                                start - view->received_us, end - start,
+                                now - view->received_us);
+    if (server->access_log)
+        log_access(server, view->req, status, bytes_out,
+                   start - view->received_us, end - start, now - view->received_us);
+}
+
+void record_response(const restinio_request_t *view, const restinio_response_t *resp) {
+    if (!view->received_us)
+        return;
+    if (resp->destroy == release_response_builder) {
+        auto b = reinterpret_cast<const restinio_response_builder_t *>(resp);
+        uint64_t bytes = 0;
+        for (const auto &item : b->items)
+            bytes += item.length;
+        record_metrics(view, b->status_code, bytes);
+    } else if (resp->error_code != 0) {
+        record_metrics(view, 500, resp->error_message ? strlen(resp->error_message) : 0);
+    } else {
+        size_t length = resp->response_length;
+        if (!length && resp->response)
+            length = strlen(resp->response);
+        record_metrics(view, 200, length);
+    }
+}
+
+void fill_cache(const restinio_request_t *view, const restinio_response_t *resp);
+
+// Everything short of writing: the route's cache, 304s, compression and
+// metrics.  Runs on whichever thread produced the response.
+restinio_response_t *prepare_response(
+    const restinio_request_t *view,
+    restinio_response_t *user_resp,
+    bool *vary) {
+    if (view->cache_pending)
+        fill_cache(view, user_resp);
+    user_resp = not_modified_response(view, user_resp);
+
+    *vary = false;
+    if (view->route && view->route->compress_min_bytes)
+        user_resp = compress_response(view, user_resp, vary);
+    record_response(view, user_resp);
+    return user_resp;
+}
+
+restinio::request_handling_status_t write_response(
+    const restinio_request_t *view,
+    restinio_response_t *user_resp,
+    bool vary) {
+    const restinio::request_handle_t &req = view->req;
+
+    // while draining, keep-alive connections close after this response
+    bool close = view->server && view->server->draining;
+
+    if (user_resp->destroy == release_response_builder)
+        return send_builder_response(
+            req, reinterpret_cast<restinio_response_builder_t *>(user_resp), close);
+
+    auto rb = user_resp->error_code != 0
+        ? req->create_response(restinio::status_internal_server_error())
+        : req->create_response(restinio::status_ok());
+    apply_headers_from_user(rb, user_resp->headers);
+    if (vary)
+        rb.append_header(restinio::http_field::vary, "Accept-Encoding");
+    if (close)
+        rb.connection_close();
+    if (user_resp->error_code != 0) {
+        rb.set_body(
+            user_resp->error_message
+            ? user_resp->error_message
+            : "Error occurred, but no message provided");
+    } else {
+        // response_length is authoritative; 0 falls back to a C string
+        size_t length = user_resp->response_length;
+        if (!length && user_resp->response)
+            length = strlen(user_resp->response);
+
+        if (user_resp->destroy && length) {
+            // The response owns its body: send it in place and destroy it
+            // only once the bytes have been written.
+            restinio_destroy_cb destroy_cb = user_resp->destroy;
+            rb.set_body(restinio::const_buffer(user_resp->response, length));
+            return rb.done([user_resp, destroy_cb](const restinio::asio_ns::error_code &) {
+                destroy_cb(user_resp);
+            });
+        }
+        rb.set_body(std::string(user_resp->response ? user_resp->response : "", length));
+    }
+
+    if (user_resp->destroy) {
+        restinio_destroy_cb destroy_cb = user_resp->destroy;
+        destroy_cb(user_resp);
+    }
+    return rb.done();
+}
+
+restinio::request_handling_status_t send_response(
+    const restinio_request_t *view,
+    restinio_response_t *user_resp) {
+    bool vary;
+    user_resp = prepare_response(view, user_resp, &vary);
+    return write_response(view, user_resp, vary);
+}
+
+// Chunks are flushed automatically once this much is buffered, so a
+// producer that never calls restinio_stream_flush() stays bounded too.
+constexpr size_t stream_auto_flush_bytes = 64 * 1024;
+
+// The notificator for the bytes written since the previous flush
+restinio::write_status_cb_t stream_write_notificator(restinio_stream_t *s) {
+    auto state = s->state;
+    size_t bytes = s->unflushed;
+    s->unflushed = 0;
+    std::vector<std::pair<restinio_release_cb, void *>> releases;
+    releases.swap(s->releases);
+    return [state, bytes, releases](const restinio::asio_ns::error_code &ec) {
+        for (const auto &r : releases)
+            r.first(r.second);
+        if (ec)
+            state->failed = true;
+
+        size_t pending = state->pending.fetch_sub(bytes) - bytes;
+        if (pending <= state->high_watermark / 2 && state->paused.exchange(false)) {
+            if (state->on_drain)
+                state->on_drain(state->drain_arg);
+        }
+    };
+}
+
+bool stream_queued(restinio_stream_t *s, size_t length) {
+    auto &state = *s->state;
+    s->unflushed += length;
+    size_t pending = state.pending.fetch_add(length) + length;
+    bool over = state.high_watermark && pending > state.high_watermark;
+
+    // Paused before flushing, so the write that drains the backlog sees it.
+    // on_drain only comes from a finished write, so going over the mark
+    // flushes whatever is buffered, however little.
+    if (over)
+        state.paused = true;
+    if (over || s->unflushed >= stream_auto_flush_bytes)
+        s->rb.flush(stream_write_notificator(s));
+    if (!over)
+        return true;
+
+    // writes that finished since the fetch_add may have drained it already
+    if (state.pending.load() <= state.high_watermark / 2 && state.paused.exchange(false))
+        return true;
+    // false only while on_drain is still to come
+    return !state.paused.load();
+}
+
+void request_finished(restinio_server_t *server, bool detached) {
+    if (detached)
+        server->detached.fetch_sub(1);
+    if (server->in_flight.fetch_sub(1) == 1 && server->draining) {
+        std::lock_guard<std::mutex> lock(server->drain_mutex);
+        server->drained.notify_all();
+    }
+}
+
+restinio_server_t::detached_stripe_t &pending_stripe(restinio_server_t *server,
+                                                     uint64_t connection_id) {
+    return server->pending[connection_id % restinio_server_t::detached_stripes];
+}
+
+void register_detached(restinio_request_t *handle) {
+    auto &stripe = pending_stripe(handle->server, handle->req->connection_id());
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    handle->state.next = stripe.head;
+    if (stripe.head)
+        stripe.head->state.prev = handle;
+    stripe.head = handle;
+    handle->state.registered = true;
+}
+
+// Caller holds the stripe's mutex
+void unlink_detached(restinio_server_t::detached_stripe_t &stripe, restinio_request_t *handle) {
+    handle_state_t &state = handle->state;
+    if (state.prev)
+        state.prev->state.next = state.next;
+    else
+        stripe.head = state.next;
+    if (state.next)
+        state.next->state.prev = state.prev;
+    state.prev = state.next = nullptr;
+    state.registered = false;
+}
+
+void unregister_detached(restinio_request_t *handle) {
+    auto &stripe = pending_stripe(handle->server, handle->req->connection_id());
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    if (handle->state.registered)
+        unlink_detached(stripe, handle);
+}
+
+// Tells the route a detached request was cancelled and drops the reference
+// the canceller took.  Runs on an I/O thread.
+void notify_cancelled(restinio_request_t *handle) {
+    if (handle->state.deadline)
+        handle->state.deadline->cancel();
+    const restinio_route_t *route = handle->route;
+    if (route && route->cancel_cb)
+        route->cancel_cb(route->arg, handle);
+    release_handle(handle);
+}
+
+// The route's deadline passed first: the client gets a 504 now and the
+// handler's eventual response is dropped
+void deadline_expired(restinio_request_t *handle) {
+    int expected = handle_pending;
+    if (!handle->state.outcome.compare_exchange_strong(expected, handle_cancelled,
+                                                       std::memory_order_acq_rel))
+        return;
+    unregister_detached(handle);
+    handle->state.refs.fetch_add(1, std::memory_order_relaxed);
+    static const char body[] = "Gateway Timeout";
+    record_metrics(handle, 504, sizeof(body) - 1);
+    bool close = handle->server && handle->server->draining;
+    auto rb = handle->req->create_response(status_line(504));
+    if (close)
+        rb.connection_close();
+    rb.set_body(body);
+    rb.done();
+    notify_cancelled(handle);
+}
+
+// Registers a new detached handle for cancellation and arms its route's
+// deadline.  Runs on the I/O thread that received the request.
+void watch_detached(restinio_request_t *handle) {
+    register_detached(handle);
+    const restinio_route_t *route = handle->route;
+    restinio::asio_ns::io_context *io_context =
+        handle->completions ? handle->completions->io_context.load() : nullptr;
+    if (!route->deadline_ms || !io_context)
+        return;
+    handle->state.deadline = new restinio::asio_ns::steady_timer(
+        *io_context, std::chrono::milliseconds(route->deadline_ms));
+    handle->state.refs.fetch_add(1, std::memory_order_relaxed);
+    handle->state.deadline->async_wait([handle](const restinio::asio_ns::error_code &ec) {
+        if (!ec)
+            deadline_expired(handle);
+        release_handle(handle);
+    });
+}
+
+// Claims a detached handle for its response.  false if it was cancelled:
+// the handle is then released here and the caller only drops the response.
+bool claim_detached(restinio_request_t *handle) {
+    if (!handle->detached)
+        return true;
+    unregister_detached(handle);
+    int expected = handle_pending;
+    if (handle->state.outcome.compare_exchange_strong(expected, handle_finished,
+                                                      std::memory_order_acq_rel)) {
+        if (handle->state.deadline)
+            handle->state.deadline->cancel();
+        return true;
+    }
+    restinio_server_t *server = handle->server;
+    release_handle(handle);
+    if (server)
+        request_finished(server, true);
+    return false;
+}
+
+void drop_response(restinio_response_t *response) {
+    if (response && response->destroy)
+        response->destroy(response);
+}
+
+// Sends every queued completion, oldest first.  Runs on the queue's
+// io_context, so each write is handed to its connection without another
+// cross-thread wakeup.
+void drain_completions(restinio_completion_queue_t *queue) {
+    restinio_request_t *list = queue->head.exchange(nullptr, std::memory_order_acquire);
+    restinio_request_t *ordered = nullptr;
+    while (list) {
+        restinio_request_t *next = list->next_completion;
+        list->next_completion = ordered;
+        ordered = list;
+        list = next;
+    }
+    while (ordered) {
+        restinio_request_t *handle = ordered;
+        ordered = handle->next_completion;
+        write_response(handle, handle->completion, handle->completion_vary);
+        restinio_server_t *server = handle->server;
+        bool detached = handle->detached;
+        release_handle(handle);
+        request_finished(server, detached);
+    }
+}
+
+// true if the response was queued; false when the caller is already on the
+// request's I/O thread (or it has none, or it has stopped) and should send
+// it directly
+bool queue_completion(restinio_request_t *handle, restinio_response_t *response) {
+    restinio_completion_queue_t *queue = handle->completions;
+    if (!queue || queue->closed.load())
+        return false;
+    restinio::asio_ns::io_context *io_context = queue->io_context.load();
+    if (!io_context || io_context->get_executor().running_in_this_thread())
+        return false;
+
+    handle->completion = prepare_response(handle, response, &handle->completion_vary);
+    restinio_request_t *head = queue->head.load(std::memory_order_relaxed);
+    do {
+        handle->next_completion = head;
+    } while (!queue->head.compare_exchange_weak(head, handle,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed));
+    // only the push onto an empty queue schedules a drain.  A queue closed
+    // since the check above may already have been emptied by the stop, and
+    // its context will not run the post, so send from here.
+    if (!head) {
+        if (queue->closed.load())
+            drain_completions(queue);
+        else
+            restinio::asio_ns::post(*io_context, [queue] { drain_completions(queue); });
+    }
+    return true;
+}
+
+// Points queue at an io_context about to run
+void open_completions(restinio_completion_queue_t *queue,
+                      restinio::asio_ns::io_context *io_context) {
+    queue->io_context.store(io_context);
+    queue->closed.store(false);
+}
+
+// Once the queue's io_context has stopped, sends what is still queued from
+// the calling thread; later completions no longer queue (see above)
+void close_completions(restinio_completion_queue_t *queue) {
+    queue->closed.store(true);
+    drain_completions(queue);
+}
+
+// Fast rejection while draining or over max_in_flight
+restinio::request_handling_status_t service_unavailable(
+    restinio_server_t *server,
+    const restinio::request_handle_t &req,
+    bool close) {
+    static const char body[] = "Service Unavailable";
+    if (server->access_log)
+        log_access(server, req, 503, sizeof(body) - 1, 0, 0, 0);
+    auto rb = req->create_response(status_line(503));
+    rb.append_header(restinio::http_field::retry_after, "1");
+    if (close)
+        rb.connection_close();
+    rb.set_body(body);
+    return rb.done();
+}
+
+restinio::request_handling_status_t no_response(
+    const restinio::request_handle_t &req,
+    bool close) {
+    auto rb = req->create_response(restinio::status_not_implemented())
+        .set_body("No callback set or callback returned null");
+    if (close)
+        rb.connection_close();
+    return rb.done();
+}
+
+// 413 for a body over the route's limit, or 400 when its chunk callback
+// gives up.  The connection is closed: the client may still be sending.
+restinio::request_handling_status_t reject_request(
+    const restinio_request_t *view,
+    int status,
+    const char *body) {
+    size_t length = strlen(body);
+    record_metrics(view, status, length);
+    return view->req->create_response(status_line(status))
+        .connection_close()
+        .set_body(std::string(body, length))
+        .done();
+}
+
+bool body_too_large(const restinio_request_t *view) {
+    size_t limit = view->route->max_body_size;
+    return limit && view->req->body().size() > limit;
+}
+
+// Feeds the body to the route's chunk callback: one call per chunk of a
+// chunked upload, in order, or one for the whole body.  false if the
+// callback gave up.
+bool consume_body_chunks(restinio_request_t *view) {
+    const restinio_route_t *route = view->route;
+    const std::string &body = view->req->body();
+    const auto *chunks = view->req->chunked_input_info();
+    if (!chunks || !chunks->chunk_count())
+        return body.empty() || route->body_chunk_cb(route->arg, view, body.data(), body.size());
+    for (size_t i = 0; i < chunks->chunk_count(); i++) {
+        auto chunk = chunks->chunk_at_nothrow(i).make_string_view_nothrow(body);
+        if (!route->body_chunk_cb(route->arg, view, chunk.data(), chunk.size()))
+            return false;
+    }
+    return true;
+}
+
+// Serves a static route: no callback, no copy of the body, and a 304 when
+// If-None-Match names its ETag
+restinio::request_handling_status_t send_static(const restinio_request_t *view) {
+    const static_response_t &s = *view->route->static_response;
+    bool close = view->server && view->server->draining;
+
+    const std::string *condition = s.etag.empty() || !conditional_method(view)
+        ? nullptr : request_field(view, "If-None-Match");
+    if (condition && if_none_match(*condition, s.etag)) {
+        record_metrics(view, 304, 0);
+        auto rb = view->req->create_response(status_line(304));
+        for (const auto &h : s.headers) {
+            if (header_is(h.first, "ETag") || header_is(h.first, "Cache-Control") ||
+                header_is(h.first, "Expires") || header_is(h.first, "Vary"))
+                rb.append_header(h.first, h.second);
+        }
+        if (close)
+            rb.connection_close();
+        return rb.done();
+    }
+
+    record_metrics(view, s.status_code, s.body.size());
+    auto rb = view->req->create_response(s.status_line);
+    for (const auto &h : s.headers)
+        rb.append_header(h.first, h.second);
+    if (close)
+        rb.connection_close();
+    rb.set_body(restinio::const_buffer(s.body.data(), s.body.size()));
+    return rb.done();
+}
+
+// Runs a blocking route's callback for a handle
+restinio_response_t *run_callback(restinio_request_t *handle) {
+    const restinio_route_t *handler = handle->route;
+    const auto &req = handle->req;
+    restinio_response_t *user_resp;
+    if (handle->received_us)
+        handle->handler_start_us = now_us();
+    if (handler->view_cb) {
+        user_resp = handler->view_cb(handler->arg, handle);
+    } else {
+        const std::string &uri_str = req->header().request_target();
+        const std::string &body = req->body();
+        user_resp = handler->cb(handler->arg,
+                                req->header().method().c_str(),
+                                uri_str.c_str(),
+                                body.data(),
+                                body.size());
+    }
+    if (handle->received_us)
+        handle->handler_end_us = now_us();
+    return user_resp;
+}
+
+// Calls f(key, value) for each header of a cached response
+template<typename F>
+void each_cached_header(const restinio_cached_response_t *entry, F &&f) {
+    const char *h = entry->headers;
+    for (size_t i = 0; i < entry->num_headers; i++) {
+        restinio::string_view_t key{h};
+        restinio::string_view_t value{h + key.size() + 1};
+        f(key, value);
+        h = value.data() + value.size() + 1;
+    }
+}
+
+// Serves a cached response in place, holding a reference to the entry until
+// it is written.  Compressing routes send a copy through the usual path so
+// gzip and Vary still apply.
+restinio::request_handling_status_t send_cached(const restinio_request_t *view,
+                                                const restinio_cached_response_t *entry) {
+    if (view->route->compress_min_bytes) {
+        restinio_response_builder_t *b = restinio_response_builder(entry->status);
+        each_cached_header(entry, [b](restinio::string_view_t key, restinio::string_view_t value) {
+            restinio_response_builder_header_n(b, key.data(), key.size(), value.data(), value.size());
+        });
+        restinio_response_builder_body(b, entry->body, entry->body_length);
+        return send_response(view, restinio_response_builder_finish(b));
+    }
+
+    bool close = view->server && view->server->draining;
+    const std::string *condition = entry->status == 200 && entry->etag && conditional_method(view)
+        ? request_field(view, "If-None-Match") : nullptr;
+    if (condition && if_none_match(*condition, entry->etag)) {
+        record_metrics(view, 304, 0);
+        auto rb = view->req->create_response(status_line(304));
+        each_cached_header(entry, [&rb](restinio::string_view_t key, restinio::string_view_t value) {
+            if (header_is(key, "ETag") || header_is(key, "Last-Modified") ||
+                header_is(key, "Cache-Control") || header_is(key, "Expires") ||
+                header_is(key, "Vary") || header_is(key, "Content-Location"))
+                rb.append_header(std::string(key), std::string(value));
+        });
+        if (close)
+            rb.connection_close();
+        return rb.done();
+    }
+
+    record_metrics(view, entry->status, entry->body_length);
+    auto rb = view->req->create_response(status_line(entry->status));
+    each_cached_header(entry, [&rb](restinio::string_view_t key, restinio::string_view_t value) {
+        rb.append_header(std::string(key), std::string(value));
+    });
+    if (close)
+        rb.connection_close();
+    restinio_cached_response_retain(entry);
+    rb.set_body(restinio::const_buffer(entry->body, entry->body_length));
+    return rb.done([entry](const restinio::asio_ns::error_code &) {
+        restinio_cached_response_release(entry);
+    });
+}
+
+// What a waiter gets when its leader has no response to share: 0 routes it
+// again (see rerun_waiter), otherwise that status (a 503)
+struct cache_fallback_t {
+    int status;
+};
+
+void rerun_waiter(restinio_request_t *handle);
+
+// Answers a request parked behind a concurrent miss.  Runs on the leader's
+// thread.
+void serve_waiter(void *waiter, const restinio_cached_response_t *entry, void *arg) {
+    auto handle = static_cast<restinio_request_t *>(waiter);
+    restinio_server_t *server = handle->server;
+    if (!entry && !static_cast<cache_fallback_t *>(arg)->status) {
+        rerun_waiter(handle);
+        return;
+    }
+    if (entry) {
+        send_cached(handle, entry);
+    } else {
+        server->rejected_overload.fetch_add(1, std::memory_order_relaxed);
+        service_unavailable(server, handle->req, server->draining);
+    }
+    release_handle(handle);
+    request_finished(server, false);
+}
+
+void *park_waiter(void *arg) {
+    return acquire_handle(*static_cast<const restinio_request_t *>(arg));
+}
+
+// Completes a miss the leader will not fill, see cache_fallback_t
+void abandon_cache(restinio_request_t *view, int status) {
+    cache_fallback_t fallback{status};
+    restinio_response_cache_abandon(view->route->cache, view->cache_pending,
+                                     serve_waiter, &fallback);
+    view->cache_pending = nullptr;
+}
+
+// true if a Cache-Control value contains directive (case-insensitive)
+bool has_directive(restinio::string_view_t value, const char *directive) {
+    size_t length = strlen(directive);
+    for (size_t i = 0; i + length <= value.size(); i++) {
+        if (!strncasecmp(value.data() + i, directive, length))
+            return true;
+    }
+    return false;
+}
+
+// Publishes the leader's response, before 304s and compression, to the
+// route's cache and to the requests waiting on it.  Responses with file
+// slices cannot be copied, and ones carrying Set-Cookie or Cache-Control:
+// private/no-store belong to the leader's client alone; the waiters of
+// either are routed again, each on its own thread.
+void fill_cache(const restinio_request_t *view, const restinio_response_t *resp) {
+    restinio_response_cache_t *cache = view->route->cache;
+    restinio_cache_pending_t *pending = view->cache_pending;
+
+    std::vector<struct iovec> body;
+    int status_code;
+    if (resp->destroy == release_response_builder) {
+        auto *b = reinterpret_cast<restinio_response_builder_t *>(const_cast<restinio_response_t *>(resp));
+        for (const auto &item : b->items) {
+            if (item.file >= 0) {
+                cache_fallback_t rerun{0};
+                restinio_response_cache_abandon(cache, pending, serve_waiter, &rerun);
+                return;
+            }
+            const char *data = item.data ? item.data : b->body.data() + item.offset;
+            body.push_back(iovec{const_cast<char *>(data), item.length});
+        }
+        status_code = b->status_code;
+    } else if (resp->error_code != 0) {
+        const char *message = resp->error_message
+            ? resp->error_message : "Error occurred, but no message provided";
+        body.push_back(iovec{const_cast<char *>(message), strlen(message)});
+        status_code = 500;
+    } else {
+        size_t length = resp->response_length;
+        if (!length && resp->response)
+            length = strlen(resp->response);
+        body.push_back(iovec{const_cast<char *>(resp->response ? resp->response : ""), length});
+        status_code = 200;
+    }
+
+    std::string headers;
+    size_t num_headers = 0;
+    bool shareable = true;
+    each_header(resp, [&](restinio::string_view_t key, restinio::string_view_t value) {
+        if (header_is(key, "Content-Length"))
+            return;
+        if (header_is(key, "Set-Cookie") ||
+            (header_is(key, "Cache-Control") &&
+             (has_directive(value, "no-store") || has_directive(value, "private"))))
+            shareable = false;
+        headers.append(key.data(), key.size()).push_back('\0');
+        headers.append(value.data(), value.size()).push_back('\0');
+        num_headers++;
+    });
+    if (!shareable) {
+        cache_fallback_t rerun{0};
+        restinio_response_cache_abandon(cache, pending, serve_waiter, &rerun);
+        return;
+    }
+
+    // waiters only see the fallback if the entry cannot be allocated
+    cache_fallback_t reject{503};
+    const restinio_cached_response_t *entry = restinio_response_cache_fill(
+        cache, pending, status_code, headers.data(), headers.size(), num_headers,
+        body.data(), static_cast<int>(body.size()), status_code == 200,
+        serve_waiter, &reject);
+    if (entry)
+        restinio_cached_response_release(entry);
+}
+
+// method, target and the route's vary headers, NUL separated; a header
+// that is present starts with '='
+const std::string &cache_key(const restinio_request_t *view) {
+    thread_local std::string key;
+    const auto &header = view->req->header();
+    key.assign(header.method().c_str());
+    key.push_back('\0');
+    key.append(header.request_target());
+    for (const char *name = view->route->cache_vary; name && *name; name += strlen(name) + 1) {
+        key.push_back('\0');
+        if (const std::string *value = request_field(view, name)) {
+            key.push_back('=');
+            key.append(*value);
+        }
+    }
+    return key;
+}
+
+// Runs a blocking route's callback on a pool worker.  The response goes
+// back to the I/O threads through the completion queue, like a detached
+// one finished from a worker.
+void run_blocking(void *arg) {
+    auto handle = static_cast<restinio_request_t *>(arg);
+    const restinio_route_t *handler = handle->route;
+    restinio_server_t *server = handle->server;
+    const auto &req = handle->req;
+
+    if (handler->body_chunk_cb && !consume_body_chunks(handle)) {
+        if (handle->cache_pending)
+            abandon_cache(handle, 0);
+        reject_request(handle, 400, "Bad Request");
+        release_handle(handle);
+        request_finished(server, false);
+        return;
+    }
+
+    restinio_response_t *user_resp = run_callback(handle);
+    if (user_resp && queue_completion(handle, user_resp))
+        return;
+    if (user_resp) {
+        send_response(handle, user_resp);
+    } else {
+        if (handle->cache_pending)
+            abandon_cache(handle, 0);
+        record_metrics(handle, 501, 0);
+        no_response(req, server->draining);
+    }
+
+    release_handle(handle);
+    request_finished(server, false);
+}
+
+// Answers a blocking request the drain deadline left in the worker queues
+void cancel_blocking(void *arg) {
+    auto handle = static_cast<restinio_request_t *>(arg);
+    restinio_server_t *server = handle->server;
+    if (handle->cache_pending)
+        abandon_cache(handle, 503);
+    server->rejected_draining.fetch_add(1, std::memory_order_relaxed);
+    service_unavailable(server, handle->req, true);
+    release_handle(handle);
+    request_finished(server, false);
+}
+
+// Offers a request, already counted in flight, to its matching routes in
+// registration order until one answers it or takes it over.  With resume
+// set, routing picks up at that route, which has already admitted the
+// request (limits, body chunks, cache lookup) and only runs its callback.
+restinio::request_handling_status_t route_request(restinio_request_t &view,
+                                                  const restinio_route_t *resume) {
+    restinio_server_t *server = view.server;
+    const auto &req = view.req;
+    auto method_str = req->header().method();
+    const std::string &uri_str = req->header().request_target();
+    const std::string &body = req->body();
+    restinio_response_t *user_resp = nullptr;
+
+    // Candidates come back in registration order, first match wins
+    const uint32_t *candidates = nullptr;
+    size_t num_candidates = server->route_table
+        ? restinio_route_table_match(server->route_table,
+                                     method_str.c_str(), strlen(method_str.c_str()),
+                                     uri_str.data(), uri_str.size(),
+                                     &candidates)
+        : 0;
+
+    restinio_route_t *handler = nullptr;
+    for(size_t i = 0; i < num_candidates; i++) {
+        if(resume && candidates[i] != resume->index)
+            continue;
+        // routes with {params} can still reject the target here
+        if(!restinio_route_table_capture(server->route_table, candidates[i],
+                                         uri_str.data(), uri_str.size(),
+                                         view.params, &view.num_params))
+            continue;
+
+        handler = server->routes[candidates[i]];
+        view.route = handler;
+        bool resumed = resume != nullptr;
+        resume = nullptr;
+        if(!resumed && body_too_large(&view)) {
+            request_finished(server, false);
+            return reject_request(&view, 413, "Payload Too Large");
+        }
+        if(!resumed && handler->static_response) {
+            auto status = send_static(&view);
+            request_finished(server, false);
+            return status;
+        }
+        if(!resumed && handler->body_chunk_cb && !(handler->blocking && server->workers) &&
+           !consume_body_chunks(&view)) {
+            request_finished(server, false);
+            return reject_request(&view, 400, "Bad Request");
+        }
+        bool detached = handler->detached_cb || handler->detached_view_cb;
+        if(!resumed && handler->cache && !detached &&
+           req->header().method() == restinio::http_method_get()) {
+            const std::string &key = cache_key(&view);
+            const restinio_cached_response_t *entry;
+            switch(restinio_response_cache_lookup(handler->cache, key.data(), key.size(),
+                                                  park_waiter, &view,
+                                                  &entry, &view.cache_pending)) {
+            case RESTINIO_CACHE_HIT: {
+                auto status = send_cached(&view, entry);
+                restinio_cached_response_release(entry);
+                request_finished(server, false);
+                return status;
+            }
+            case RESTINIO_CACHE_WAIT:
+                return restinio::request_accepted(); // answered by the leader
+            case RESTINIO_CACHE_MISS:
+                break;
+            }
+        }
+        if(detached) {
+            // The handle keeps the request alive until it is finished
+            if (view.received_us)
+                view.handler_start_us = now_us();
+            restinio_request_t *handle = acquire_handle(view);
+            handle->detached = true;
+            server->detached.fetch_add(1);
+            watch_detached(handle);
+            if(handler->detached_cb)
+                handler->detached_cb(
+                    handler->arg,
+                    method_str.c_str(),
+                    uri_str.c_str(),
+                    body.data(),
+                    body.size(),
+                    static_cast<void*>(handle)
+                );
+            else
+                handler->detached_view_cb(handler->arg, handle, static_cast<void*>(handle));
+            return restinio::request_accepted(); // Indicate detached handling
+        }
+        if(handler->blocking && server->workers) {
+            restinio_request_t *handle = acquire_handle(view);
+            if(!restinio_worker_pool_submit(server->workers, run_blocking, handle)) {
+                if(view.cache_pending)
+                    abandon_cache(&view, 503);
+                release_handle(handle);
+                request_finished(server, false);
+                server->rejected_overload.fetch_add(1, std::memory_order_relaxed);
+                return service_unavailable(server, req, server->draining);
+            }
+            return restinio::request_accepted();
+        }
+        if(view.received_us)
+            view.handler_start_us = now_us();
+        if(handler->view_cb)
+            user_resp = handler->view_cb(handler->arg, &view);
+        else
+            user_resp = handler->cb(
+                handler->arg,
+                method_str.c_str(),
+                uri_str.c_str(),
+                body.data(),
+                body.size()
+            );
+        if(user_resp)
+            break;
+        if(view.cache_pending)
+            abandon_cache(&view, 0);
+    }
+    if(user_resp) {
+        if(view.received_us)
+            view.handler_end_us = now_us();
+        auto status = send_response(&view, user_resp);
+        request_finished(server, false);
+        return status;
+    }
+    else {
+        request_finished(server, false);
+        server->unrouted.fetch_add(1, std::memory_order_relaxed);
+        view.route = nullptr;
+        record_metrics(&view, 501, 0);
+        return no_response(req, server->draining);
+    }
+}
+
+// Routes a waiter whose leader's response could not be shared as though it
+// had missed itself.  Runs on the waiter's own I/O thread.
+void resume_waiter(restinio_request_t *handle) {
+    route_request(*handle, handle->route);
+    release_handle(handle);
+}
+
+// A resumption still queued when its io_context is destroyed only lets go
+// of the request
+struct unrun_waiter_t {
+    void operator()(restinio_request_t *handle) const {
+        restinio_server_t *server = handle->server;
+        release_handle(handle);
+        request_finished(server, false);
+    }
+};
+
+// Sends a waiter back through dispatch from the leader's thread: blocking
+// routes go to the pool, anything else to the waiter's I/O thread, or runs
+// here once that thread has stopped taking work.
+void rerun_waiter(restinio_request_t *handle) {
+    restinio_server_t *server = handle->server;
+    if (handle->route->blocking && server->workers) {
+        if (!restinio_worker_pool_submit(server->workers, run_blocking, handle)) {
+            server->rejected_overload.fetch_add(1, std::memory_order_relaxed);
+            service_unavailable(server, handle->req, server->draining);
+            release_handle(handle);
+            request_finished(server, false);
+        }
+        return;
+    }
+    restinio_completion_queue_t *queue = handle->completions;
+    restinio::asio_ns::io_context *io_context =
+        queue && !queue->closed.load() ? queue->io_context.load() : nullptr;
+    if (!io_context) {
+        resume_waiter(handle);
+        return;
+    }
+    std::unique_ptr<restinio_request_t, unrun_waiter_t> waiter(handle);
+    restinio::asio_ns::post(*io_context, [waiter = std::move(waiter)]() mutable {
+        resume_waiter(waiter.release());
+    });
+}
+
+/**
+ * Creates the request handler with a modern approach.
+ * Removes references to restinio::own_string_t, which no longer exist.
+ */
+auto make_request_handler(restinio_server_t *server,
+                          restinio_completion_queue_t *completions) {
+    return [server, completions](auto req) mutable {
+        // Counted before draining is checked (both sequentially consistent):
+        // either restinio_server_drain sees this request in flight, or the
+        // request sees draining and backs out
+        size_t in_flight = server->in_flight.fetch_add(1);
+        if (server->draining) {
+            request_finished(server, false);
+            server->rejected_draining.fetch_add(1, std::memory_order_relaxed);
+            return service_unavailable(server, req, true);
+        }
+        if (server->options.max_in_flight && in_flight >= server->options.max_in_flight) {
+            request_finished(server, false);
+            server->rejected_overload.fetch_add(1, std::memory_order_relaxed);
+            return service_unavailable(server, req, false);
+        }
+
+        restinio_request_t view{};
+        view.req = req;
+        view.server = server;
+        view.completions = completions;
+        if (server->metrics || server->access_log)
+            view.received_us = now_us();
+        return route_request(view, nullptr);
+    };
+}
+
+void freeze_routes(restinio_server_t *server) {
+    std::vector<restinio_route_spec_t> specs;
+    server->routes.clear();
+    for(restinio_route_t *handler = server->routes_head; handler; handler = handler->next) {
+        handler->server = server;
+        handler->index = static_cast<uint32_t>(server->routes.size());
+        server->routes.push_back(handler);
+        specs.push_back(restinio_route_spec_t{handler->method, handler->path});
+    }
+    restinio_route_table_destroy(server->route_table);
+    server->route_table = restinio_route_table_build(specs.data(), specs.size());
+    if (!server->route_table)
+        std::cerr << "restinio_server_run failed to build the route table\n";
+
+    if (server->options.enable_metrics &&
+        (!server->metrics || restinio_metrics_slots(server->metrics) != server->routes.size())) {
+        restinio_metrics_destroy(server->metrics);
+        server->metrics = restinio_metrics_create(server->routes.size());
+    }
+
+    bool blocking = false;
+    size_t largest_limit = 0;
+    bool every_route_limited = !server->routes.empty();
+    for(restinio_route_t *handler : server->routes) {
+        blocking = blocking || handler->blocking;
+        largest_limit = std::max(largest_limit, handler->max_body_size);
+        every_route_limited = every_route_limited && handler->max_body_size;
+    }
+    server->read_body_limit = server->options.max_body_size
+        ? server->options.max_body_size
+        : every_route_limited ? largest_limit : 0;
+    if (blocking && !server->workers) {
+        const restinio_options_t &options = server->options;
+        size_t threads = options.worker_threads > 0
+            ? static_cast<size_t>(options.worker_threads)
+            : std::max(1u, std::thread::hardware_concurrency());
+        server->workers = restinio_worker_pool_create(
+            threads, options.worker_queue_depth ? options.worker_queue_depth : 256);
+        if (!server->workers)
+            std::cerr << "restinio_server_run failed to start the worker pool; "
+                         "blocking routes run on the I/O threads\n";
+    }
+
+    if (server->options.access_log_path && !server->access_log) {
+        server->access_log = restinio_access_log_open(server->options.access_log_path,
+                                                      server->options.access_log_format,
+                                                      server->options.access_log_ring_entries);
+        if (!server->access_log)
+            std::cerr << "restinio_server_run cannot open the access log "
+                      << server->options.access_log_path << "\n";
+    }
+}
+
+template<typename Traits>
+restinio::server_settings_t<Traits> make_settings(restinio_server_t *server,
+                                                  restinio_completion_queue_t *completions) {
+    using namespace restinio;
+    const restinio_options_t &options = server->options;
+
+    auto settings = server_settings_t<Traits>{}
+        .port(options.port)
+        .address(server->address.empty() ? std::string("0.0.0.0") : server->address)
+        .request_handler(make_request_handler(server, completions))
+        .connection_state_listener(
+            std::make_shared<restinio_c_connection_listener_t>(
+                restinio_c_connection_listener_t{server}))
+        // Keepalive-like settings:
+        .read_next_http_message_timelimit(
+            options.read_timeout_ms ? std::chrono::milliseconds(options.read_timeout_ms)
+            : options.enable_keepalive ? std::chrono::seconds(15)
+                                       : std::chrono::seconds(60))
+        .write_http_response_timelimit(
+            options.write_timeout_ms ? std::chrono::milliseconds(options.write_timeout_ms)
+                                     : std::chrono::seconds(120))
+        .handle_request_timeout(
+            options.handler_timeout_ms ? std::chrono::milliseconds(options.handler_timeout_ms)
+                                       : std::chrono::seconds(120))
+        .separate_accept_and_create_connect(options.separate_accept_and_create_connect);
+    if (options.max_connections)
+        settings.max_parallel_connections(options.max_connections);
+    if (options.buffer_size)
+        settings.buffer_size(options.buffer_size);
+    if (options.max_pipelined_requests)
+        settings.max_pipelined_requests(options.max_pipelined_requests);
+    if (options.concurrent_accepts)
+        settings.concurrent_accepts_count(options.concurrent_accepts);
+    if (server->read_body_limit)
+        settings.incoming_http_msg_limits(
+            incoming_http_msg_limits_t{}.max_body_size(server->read_body_limit));
+
+    if (options.tcp_nodelay) {
+        settings.socket_options_setter([](socket_options_t &socket) {
+            socket.set_option(asio_ns::ip::tcp::no_delay{true});
+        });
+    }
+    if (options.reuse_port || options.shards > 0) {
+        settings.acceptor_options_setter([](acceptor_options_t &acceptor) {
+            acceptor.set_option(asio_ns::ip::tcp::acceptor::reuse_address{true});
+            acceptor.set_option(
+                asio_ns::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>{true});
+        });
+    }
+    // every shard shares the one context, and with it the session cache
+    if constexpr (std::is_same_v<Traits, restinio_c_tls_traits_t>)
+        settings.tls_context(server->tls);
+    return settings;
+}
+
+template<typename Traits>
+auto &shard_server(restinio_shard_t &shard) {
+    if constexpr (std::is_same_v<Traits, restinio_c_tls_traits_t>)
+        return shard.tls_server;
+    else
+        return shard.server;
+}
+
+void stop_shards(restinio_server_t *server) {
+    for (auto &shard : server->shards) {
+        restinio_shard_t *s = shard.get();
+        if (!s->thread.joinable())
+            continue;
+        restinio::asio_ns::post(s->io_context, [s] {
+            if (s->server)
+                s->server->close_sync();
+            else
+                s->tls_server->close_sync();
+            s->io_context.stop();
+        });
+        s->thread.join();
+        close_completions(s->completions);
+    }
+}
+
+// Each shard binds its own acceptor before its thread starts, so a failure
+// to bind is reported here rather than on the shard's thread.
+template<typename Traits>
+bool start_shards(restinio_server_t *server) {
+    unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+    try {
+        for (int i = 0; i < server->options.shards; i++) {
+            auto shard = std::make_unique<restinio_shard_t>();
+            if (server->shard_completions.size() <= static_cast<size_t>(i))
+                server->shard_completions.push_back(std::make_unique<restinio_completion_queue_t>());
+            shard->completions = server->shard_completions[i].get();
+            auto &http_server = shard_server<Traits>(*shard);
+            http_server = std::make_unique<restinio::http_server_t<Traits>>(
+                restinio::external_io_context(shard->io_context),
+                make_settings<Traits>(server, shard->completions));
+            http_server->open_sync();
+            open_completions(shard->completions, &shard->io_context);
+
+            restinio_shard_t *s = shard.get();
+            unsigned cpu = static_cast<unsigned>(i) % cpus;
+            s->thread = std::thread([s, cpu] {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                s->io_context.run();
+            });
+            server->shards.push_back(std::move(shard));
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "restinio_server_run: " << e.what() << "\n";
+        stop_shards(server);
+        return false;
+    }
+    server->stopped = false;
+    return true;
+}
+
+template<typename Traits>
+bool start_pooled(restinio_server_t *server,
+                  restinio::running_server_handle_t<Traits> &running) {
+    using namespace restinio;
+    const restinio_options_t &options = server->options;
+
+    std::size_t pool_size = options.enable_thread_pool && options.thread_pool_size > 0
+        ? static_cast<std::size_t>(options.thread_pool_size)
+        : 1;
+
+    // Owned here rather than by Restinio so detached completions can be
+    // posted to it
+    server->io_context = std::make_unique<asio_ns::io_context>();
+    open_completions(&server->completions, server->io_context.get());
+    try {
+        running = run_async<Traits>(
+            external_io_context(*server->io_context),
+            make_settings<Traits>(server, &server->completions),
+            pool_size);
+    } catch (const std::exception &e) {
+        std::cerr << "restinio_server_run: " << e.what() << "\n";
+        close_completions(&server->completions);
+        return false;
+    }
+    server->stopped = false;
+    return true;
+}
+
+std::string tls_error() {
+    char buffer[256];
+    ERR_error_string_n(ERR_get_error(), buffer, sizeof(buffer));
+    ERR_clear_error();
+    return buffer;
+}
+
+// Restinio speaks HTTP/1.1 only, so that is the one protocol we select
+int select_alpn(SSL *, const unsigned char **out, unsigned char *out_length,
+                const unsigned char *in, unsigned int in_length, void *) {
+    static const unsigned char http11[] = "\x08http/1.1";
+    unsigned char *selected;
+    if (SSL_select_next_proto(&selected, out_length, http11, sizeof(http11) - 1,
+                              in, in_length) != OPENSSL_NPN_NEGOTIATED)
+        return SSL_TLSEXT_ERR_NOACK;
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+// Points every new handshake at the most recently loaded certificate.  The
+// session cache and ticket keys stay on the original context, so sessions
+// survive a reload.
+int use_current_certificate(SSL *ssl, int *, void *arg) {
+    auto server = static_cast<restinio_server_t *>(arg);
+    std::lock_guard<std::mutex> lock(server->tls_mutex);
+    if (server->tls_certificate)
+        SSL_set_SSL_CTX(ssl, server->tls_certificate);
+    return SSL_CLIENT_HELLO_SUCCESS;
+}
+
+// SSL_set_SSL_CTX() takes the session ID context and the ALPN callback from
+// the context it switches to, so both kinds of context need them.
+void configure_handshake(SSL_CTX *ctx) {
+    static const unsigned char session_id_context[] = "restinio-c";
+    SSL_CTX_set_session_id_context(ctx, session_id_context, sizeof(session_id_context) - 1);
+    SSL_CTX_set_alpn_select_cb(ctx, select_alpn, nullptr);
+}
+
+SSL_CTX *load_certificate(const restinio_options_t &options) {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx)
+        return nullptr;
+    configure_handshake(ctx);
+    if (SSL_CTX_use_certificate_chain_file(ctx, options.cert_file) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, options.key_file, SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx) != 1) {
+        std::cerr << "restinio: cannot load " << options.cert_file << " / "
+                  << options.key_file << ": " << tls_error() << "\n";
+        SSL_CTX_free(ctx);
+        return nullptr;
+    }
+    return ctx;
+}
+
+bool make_tls_context(restinio_server_t *server) {
+    namespace ssl = restinio::asio_ns::ssl;
+    const restinio_options_t &options = server->options;
+    if (!options.cert_file || !options.key_file) {
+        std::cerr << "restinio_server_run: enable_ssl needs cert_file and key_file\n";
+        return false;
+    }
+
+    SSL_CTX *certificate = load_certificate(options);
+    if (!certificate)
+        return false;
+
+    auto tls = std::make_shared<ssl::context>(ssl::context::tls_server);
+    tls->set_options(ssl::context::default_workarounds |
+                     ssl::context::no_sslv2 | ssl::context::no_sslv3 |
+                     ssl::context::no_tlsv1 | ssl::context::no_tlsv1_1 |
+                     ssl::context::single_dh_use);
+    SSL_CTX *ctx = tls->native_handle();
+    if (SSL_CTX_use_certificate_chain_file(ctx, options.cert_file) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, options.key_file, SSL_FILETYPE_PEM) != 1) {
+        std::cerr << "restinio_server_run: " << tls_error() << "\n";
+        SSL_CTX_free(certificate);
+        return false;
+    }
+
+    configure_handshake(ctx);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, options.tls_session_cache_size
+                                ? static_cast<long>(options.tls_session_cache_size)
+                                : 20480);
+    SSL_CTX_set_timeout(ctx, 300);
+    if (options.tls_disable_tickets)
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    SSL_CTX_set_client_hello_cb(ctx, use_current_certificate, server);
+
+    std::lock_guard<std::mutex> lock(server->tls_mutex);
+    SSL_CTX_free(server->tls_certificate);
+    server->tls_certificate = certificate;
+    server->tls = std::move(tls);
+    return true;
+}
+
+// Binds the listener and starts the thread pool; run_async returns once the
+// server accepts connections, and stop() needs no polling thread.
+bool start_server(restinio_server_t *server) {
+    const restinio_options_t &options = server->options;
 
-    struct restinio_path_handler_s *next;
-} restinio_path_handler_t;
+    if (options.enable_http2)
+        std::cerr << "restinio_server_run: enable_http2 is ignored, "
+                     "HTTP/2 is not supported and Restinio serves HTTP/1.1 only\n";
 
-restinio_path_handler_t *g_path_map = NULL, *g_path_map_tail = NULL;
+    if (options.enable_ssl) {
+        if (!make_tls_context(server))
+            return false;
+        return options.shards > 0
+            ? start_shards<restinio_c_tls_traits_t>(server)
+            : start_pooled<restinio_c_tls_traits_t>(server, server->running_tls);
+    }
+    return options.shards > 0
+        ? start_shards<restinio_c_traits_t>(server)
+        : start_pooled<restinio_c_traits_t>(server, server->running);
+}
 
-static std::atomic_bool g_stop_flag{false};
+// restinio_options_t as it was before max_connections was added; callers
+// built against that header are read only this far.
+constexpr size_t legacy_options_size = offsetof(restinio_options_t, max_connections);
 
-struct ServerInstance {
-    std::unique_ptr<std::thread> server_thread;
-};
+// Copies the first size bytes of the caller's options; fields the caller
+// does not know about stay zeroed, which selects their defaults.
+void set_options(restinio_server_t *server, const restinio_options_t *options, size_t size) {
+    server->options = restinio_options_t{};
+    if (options)
+        memcpy(&server->options, options, std::min(size, sizeof(restinio_options_t)));
+    server->address = server->options.address ? server->options.address : "";
+    server->options.address = server->address.c_str();
+    if (server->options.cert_file) {
+        server->cert_file = server->options.cert_file;
+        server->options.cert_file = server->cert_file.c_str();
+    }
+    if (server->options.key_file) {
+        server->key_file = server->options.key_file;
+        server->options.key_file = server->key_file.c_str();
+    }
+    if (server->options.access_log_path) {
+        server->access_log_path = server->options.access_log_path;
+        server->options.access_log_path = server->access_log_path.c_str();
+    }
+}
 
-static std::unique_ptr<ServerInstance> g_server;
-static restinio_options_t g_options;
+restinio_server_t *default_server() {
+    if (!g_default_server)
+        g_default_server = restinio_server_create_ex(NULL, sizeof(restinio_options_t));
+    return g_default_server;
+}
 
-/**
- * 1) Instead of a single signature that takes a `response_builder_t<default_traits_t> &`,
- *    we make apply_headers_from_user a template, so it can accept *any* of the modern
- *    `response_builder_t<Traits>` types that Restinio might produce.
- *
- * 2) We replace `rb.append_header(...)` with `rb.header().set_field(...)`, which is
- *    the typical modern approach in new versions of Restinio.
- */
-template<typename Builder>
-void apply_headers_from_user(Builder &rb, restinio_header_t *hdr_list)
-{
-    for (auto *hdr = hdr_list; hdr != nullptr; hdr = hdr->next) {
-        if (hdr->key && hdr->value) {
-            // Old code: rb.append_header(hdr->key, hdr->value);
-            // Modern code:
-            rb.header().set_field(hdr->key, hdr->value);
+const restinio::query_string_params_t &request_query(const restinio_request_t *req) {
+    auto &query = req->query.params;
+    if (!query) {
+        try {
+            query.emplace(restinio::parse_query(req->req->header().query()));
+        } catch (const std::exception &) {
+            // malformed query strings read as empty
+            query.emplace(restinio::parse_query(restinio::string_view_t{}));
         }
     }
+    return *query;
 }
 
-/**
- * Creates the request handler with a modern approach.
- * Removes references to restinio::own_string_t, which no longer exist.
- */
-auto make_request_handler() {
-    return [](auto req) mutable {
-        auto method_str = req->header().method();
-        auto uri_str    = req->header().request_target();
-        std::string body(req->body());
-        restinio_response_t *user_resp = nullptr;
-
-        // Handle request dictionary
-        restinio_path_handler_t *handler = g_path_map;
-        while(handler) {
-            // a zero length method matches all methods
-            // a path matches if uri_str starts with path
-            if((!handler->method[0] || !strcmp(method_str.c_str(), handler->method)) &&
-               (!handler->path[0] || !strncmp(uri_str.c_str(), handler->path, strlen(handler->path)))) {
-                if(handler->detached_cb) {
-                    // Pass the request
-                    handler->detached_cb(
-                        handler->arg,
-                        method_str.c_str(),
-                        uri_str.c_str(),
-                        body.data(),
-                        body.size(),
-                        static_cast<void*>(new std::shared_ptr<restinio::request_t>(req))
-                    );
-                    return restinio::request_accepted(); // Indicate detached handling
-                } else {
-                    user_resp = handler->cb(
-                        handler->arg,
-                        method_str.c_str(),
-                        uri_str.c_str(),
-                        body.data(),
-                        body.size()
-                    );
-                    if(user_resp)
-                        break;
-                }
-            }
-            handler = handler->next;
-        }
-        if(handler && user_resp) {
-            if (user_resp->error_code != 0) {
-                // For an error
-                auto rb = req->create_response(restinio::status_internal_server_error());
-                rb.set_body(
-                    user_resp->error_message
-                    ? user_resp->error_message
-                    : "Error occurred, but no message provided");
-                apply_headers_from_user(rb, user_resp->headers);
-                return rb.done();
-            }
-            else {
-                auto rb = req->create_response(restinio::status_ok());
-                apply_headers_from_user(rb, user_resp->headers);
-
-                // Just set a std::string body
-                rb.set_body(user_resp->response ? user_resp->response : "");
-
-                if (user_resp->destroy) {
-                    restinio_destroy_cb destroy_cb = user_resp->destroy;
-                    destroy_cb(user_resp);
-                }
-                return rb.done();
-            }
-        }
-        else {
-            auto rb = req->create_response(restinio::status_not_implemented())
-                .set_body("No callback set or callback returned null");
-            return rb.done();
-        }
-    };
+void prometheus_label(std::string &out, const restinio_route_t *route) {
+    out += "route=\"";
+    out += route->method[0] ? route->method : "*";
+    out += ' ';
+    for (const char *p = route->path; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            out += '\\';
+        out += *p;
+    }
+    out += '"';
 }
 
-static void run_server_loop(const restinio_options_t &options) {
-    using namespace restinio;
+// Histograms are exported at powers of four microseconds, 4 us to 67 s
+void prometheus_histogram(std::string &out, const std::string &labels,
+                          const char *phase, const restinio_histogram_t &h) {
+    char line[512];
+    uint64_t cumulative = 0;
+    size_t bucket = 0;
+    for (uint64_t le = 4; le <= (uint64_t(1) << 26); le *= 4) {
+        while (bucket < RESTINIO_HISTOGRAM_BUCKETS && restinio_histogram_bucket_high(bucket) < le)
+            cumulative += h.buckets[bucket++];
+        snprintf(line, sizeof(line),
+                 "restinio_request_duration_seconds_bucket{%s,phase=\"%s\",le=\"%g\"} %llu\n",
+                 labels.c_str(), phase, static_cast<double>(le) / 1e6,
+                 static_cast<unsigned long long>(cumulative));
+        out += line;
+    }
+    snprintf(line, sizeof(line),
+             "restinio_request_duration_seconds_bucket{%s,phase=\"%s\",le=\"+Inf\"} %llu\n"
+             "restinio_request_duration_seconds_sum{%s,phase=\"%s\"} %g\n"
+             "restinio_request_duration_seconds_count{%s,phase=\"%s\"} %llu\n",
+             labels.c_str(), phase, static_cast<unsigned long long>(h.count),
+             labels.c_str(), phase, static_cast<double>(h.sum_us) / 1e6,
+             labels.c_str(), phase, static_cast<unsigned long long>(h.count));
+    out += line;
+}
 
-    // 1) Build the same server_settings as run_server_loop does:
-    auto settings = server_settings_t<default_traits_t>{}
-        .port(options.port)
-        .address(options.address ? options.address : "0.0.0.0")
-        .request_handler(make_request_handler())
-        // Keepalive-like settings:
-        .read_next_http_message_timelimit(
-            options.enable_keepalive ? std::chrono::seconds(15)
-                                     : std::chrono::seconds(60))
-        .write_http_response_timelimit(std::chrono::seconds(120))
-        .handle_request_timeout(std::chrono::seconds(120));
-
-    // 2) Decide on thread-pool size in the same way:
-    std::size_t pool_size = options.enable_thread_pool
-        ? options.thread_pool_size
-        : 1;
+restinio_response_t *metrics_handler(void *arg, restinio_request_t *) {
+    auto server = static_cast<restinio_server_t *>(arg);
+    restinio_server_metrics_t totals;
+    restinio_server_metrics(server, &totals);
 
-    // 3) Launch the server asynchronously:
-    auto server_handle = run_async<default_traits_t>(
-        own_io_context(), // The server uses its own Asio io_context
-        std::move(settings),
-        pool_size
-    );
+    std::string out;
+    char line[512];
+    snprintf(line, sizeof(line),
+             "# TYPE restinio_in_flight_requests gauge\n"
+             "restinio_in_flight_requests %zu\n"
+             "# TYPE restinio_detached_requests gauge\n"
+             "restinio_detached_requests %zu\n"
+             "# TYPE restinio_unrouted_requests_total counter\n"
+             "restinio_unrouted_requests_total %llu\n"
+             "# TYPE restinio_rejected_requests_total counter\n"
+             "restinio_rejected_requests_total{reason=\"overload\"} %llu\n"
+             "restinio_rejected_requests_total{reason=\"draining\"} %llu\n"
+             "# TYPE restinio_access_log_dropped_total counter\n"
+             "restinio_access_log_dropped_total %llu\n",
+             totals.in_flight, totals.detached,
+             static_cast<unsigned long long>(totals.unrouted),
+             static_cast<unsigned long long>(totals.rejected_overload),
+             static_cast<unsigned long long>(totals.rejected_draining),
+             static_cast<unsigned long long>(totals.access_log_dropped));
+    out += line;
+
+    static const char *phases[] = { "queue", "handler", "total" };
+    std::string requests, bytes, durations;
+    restinio_route_metrics_t m;
+    for (restinio_route_t *route : server->routes) {
+        if (!restinio_route_metrics(route, &m))
+            continue;
+        std::string labels;
+        prometheus_label(labels, route);
+        for (int i = 0; i < 6; i++) {
+            if (!m.status[i])
+                continue;
+            char status[8];
+            snprintf(status, sizeof(status), i ? "%dxx" : "other", i);
+            snprintf(line, sizeof(line), "restinio_requests_total{%s,status=\"%s\"} %llu\n",
+                     labels.c_str(), status, static_cast<unsigned long long>(m.status[i]));
+            requests += line;
+        }
+        snprintf(line, sizeof(line),
+                 "restinio_body_bytes_total{%s,direction=\"in\"} %llu\n"
+                 "restinio_body_bytes_total{%s,direction=\"out\"} %llu\n",
+                 labels.c_str(), static_cast<unsigned long long>(m.bytes_in),
+                 labels.c_str(), static_cast<unsigned long long>(m.bytes_out));
+        bytes += line;
+        const restinio_histogram_t *histograms[] = { &m.queue, &m.handler, &m.total };
+        for (int i = 0; i < 3; i++)
+            prometheus_histogram(durations, labels, phases[i], *histograms[i]);
+    }
+    out += "# TYPE restinio_requests_total counter\n" + requests;
+    out += "# TYPE restinio_body_bytes_total counter\n" + bytes;
+    out += "# TYPE restinio_request_duration_seconds histogram\n" + durations;
 
-    // Wait until Ctrl+C is pressed (signal sets g_stop_flag to true)
-    while(!g_stop_flag.load()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::string lookups, cached_bytes;
+    restinio_cache_stats_t c;
+    for (restinio_route_t *route : server->routes) {
+        if (!restinio_route_cache_stats(route, &c))
+            continue;
+        std::string labels;
+        prometheus_label(labels, route);
+        snprintf(line, sizeof(line),
+                 "restinio_cache_lookups_total{%s,result=\"hit\"} %llu\n"
+                 "restinio_cache_lookups_total{%s,result=\"miss\"} %llu\n"
+                 "restinio_cache_lookups_total{%s,result=\"coalesced\"} %llu\n",
+                 labels.c_str(), static_cast<unsigned long long>(c.hits),
+                 labels.c_str(), static_cast<unsigned long long>(c.misses),
+                 labels.c_str(), static_cast<unsigned long long>(c.coalesced));
+        lookups += line;
+        snprintf(line, sizeof(line), "restinio_cache_bytes{%s} %zu\n", labels.c_str(), c.bytes);
+        cached_bytes += line;
+    }
+    if (!lookups.empty()) {
+        out += "# TYPE restinio_cache_lookups_total counter\n" + lookups;
+        out += "# TYPE restinio_cache_bytes gauge\n" + cached_bytes;
     }
 
-    // Now gracefully stop and wait
-    server_handle->stop();
-    server_handle->wait();
+    restinio_response_builder_t *rb = restinio_response_builder(200);
+    restinio_response_builder_header(rb, "Content-Type", "text/plain; version=0.0.4");
+    restinio_response_builder_body(rb, out.data(), out.size());
+    return restinio_response_builder_finish(rb);
 }
 
 } // anonymous namespace
 
+void restinio_c_connection_listener_t::state_changed(
+    const restinio::connection_state::notice_t &notice) noexcept {
+    if (!std::get_if<restinio::connection_state::closed_t>(&notice.cause()))
+        return;
+
+    // Cancelled handles are chained through next_completion, unused until
+    // a handle is finished
+    restinio_request_t *cancelled = nullptr;
+    auto &stripe = pending_stripe(server, notice.connection_id());
+    {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        restinio_request_t *handle = stripe.head;
+        while (handle) {
+            restinio_request_t *next = handle->state.next;
+            int expected = handle_pending;
+            if (handle->req->connection_id() == notice.connection_id() &&
+                handle->state.outcome.compare_exchange_strong(expected, handle_cancelled,
+                                                              std::memory_order_acq_rel)) {
+                unlink_detached(stripe, handle);
+                handle->state.refs.fetch_add(1, std::memory_order_relaxed);
+                handle->next_completion = cancelled;
+                cancelled = handle;
+            }
+            handle = next;
+        }
+    }
+    while (cancelled) {
+        restinio_request_t *handle = cancelled;
+        cancelled = handle->next_completion;
+        notify_cancelled(handle);
+    }
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -184,34 +2202,302 @@ void restinio_finish_detached(
     const char *response_body,
     size_t response_body_length,
     restinio_header_t *headers) {
+    if (restinio_detached_cancelled(response_handle)) {
+        claim_detached(static_cast<restinio_request_t *>(response_handle));
+        return;
+    }
+    restinio_response_builder_t *b = restinio_response_builder(status_code);
+    for (auto *hdr = headers; hdr != nullptr; hdr = hdr->next) {
+        if (hdr->key && hdr->value)
+            restinio_response_builder_header(b, hdr->key, hdr->value);
+    }
+    if (response_body_length)
+        restinio_response_builder_body(b, response_body, response_body_length);
+    restinio_finish_detached_response(response_handle, restinio_response_builder_finish(b));
+}
+
+void restinio_finish_detached_owned(
+    void *response_handle,
+    int status_code,
+    const void *response_body,
+    size_t response_body_length,
+    restinio_header_t *headers,
+    restinio_release_cb release,
+    void *release_arg) {
+    if (restinio_detached_cancelled(response_handle)) {
+        claim_detached(static_cast<restinio_request_t *>(response_handle));
+        if (release)
+            release(release_arg);
+        return;
+    }
+    restinio_response_builder_t *b = restinio_response_builder(status_code);
+    for (auto *hdr = headers; hdr != nullptr; hdr = hdr->next) {
+        if (hdr->key && hdr->value)
+            restinio_response_builder_header(b, hdr->key, hdr->value);
+    }
+    restinio_response_builder_body_owned(b, response_body, response_body_length,
+                                         release, release_arg);
+    restinio_finish_detached_response(response_handle, restinio_response_builder_finish(b));
+}
 
-    // Cast the void* back to std::shared_ptr<request_t>
-    auto req_ptr = static_cast<std::shared_ptr<restinio::request_t>*>(response_handle);
-    if (!req_ptr || !(*req_ptr)) {
+void restinio_finish_detached_response(
+    void *response_handle,
+    restinio_response_t *response) {
+    auto handle = static_cast<restinio_request_t*>(response_handle);
+    if (!handle || !handle->req) {
         std::cerr << "Invalid response handle!" << std::endl;
+        drop_response(response);
+        return;
+    }
+
+    if (!claim_detached(handle)) {
+        drop_response(response);
+        return;
+    }
+    if (response && queue_completion(handle, response))
         return;
+    if (response)
+        send_response(handle, response);
+    else
+        handle->req->create_response(restinio::status_not_implemented())
+            .set_body("No response provided")
+            .done();
+
+    restinio_server_t *server = handle->server;
+    release_handle(handle);
+    if (server)
+        request_finished(server, true);
+}
+
+void restinio_finish_detached_many(
+    void *const *response_handles,
+    restinio_response_t *const *responses,
+    size_t count) {
+    for (size_t i = 0; i < count; i++)
+        restinio_finish_detached_response(response_handles[i], responses[i]);
+}
+
+restinio_stream_t *restinio_stream_begin(
+    void *response_handle,
+    int status_code,
+    restinio_header_t *headers) {
+    auto handle = static_cast<restinio_request_t*>(response_handle);
+    if (!handle || !handle->req) {
+        std::cerr << "Invalid response handle!" << std::endl;
+        return NULL;
+    }
+    if (!claim_detached(handle))
+        return NULL;
+
+    auto rb = handle->req->create_response<restinio::chunked_output_t>(status_line(status_code));
+    apply_headers_from_user(rb, headers);
+    if (handle->server && handle->server->draining)
+        rb.connection_close();
+    record_metrics(handle, status_code, 0);
+    restinio_server_t *server = handle->server;
+    release_handle(handle);
+
+    // the stream stays in flight until it is finished
+    auto *s = new restinio_stream_t(std::move(rb));
+    s->server = server;
+    // send the headers right away to cut time to first byte
+    s->rb.flush();
+    return s;
+}
+
+void restinio_stream_set_backpressure(
+    restinio_stream_t *s,
+    size_t high_watermark,
+    restinio_stream_drain_cb on_drain,
+    void *arg) {
+    s->state->high_watermark = high_watermark;
+    s->state->on_drain = on_drain;
+    s->state->drain_arg = arg;
+}
+
+bool restinio_stream_append(
+    restinio_stream_t *s,
+    const void *data,
+    size_t length) {
+    if (!length)
+        return !s->state->paused;
+    s->rb.append_chunk(std::string(static_cast<const char *>(data), length));
+    return stream_queued(s, length);
+}
+
+bool restinio_stream_append_owned(
+    restinio_stream_t *s,
+    const void *data,
+    size_t length,
+    restinio_release_cb release,
+    void *release_arg) {
+    s->rb.append_chunk(restinio::const_buffer(data, length));
+    if (release)
+        s->releases.emplace_back(release, release_arg);
+    return stream_queued(s, length);
+}
+
+void restinio_stream_flush(restinio_stream_t *s) {
+    s->rb.flush(stream_write_notificator(s));
+}
+
+size_t restinio_stream_pending(const restinio_stream_t *s) {
+    return s->state->pending.load();
+}
+
+bool restinio_stream_failed(const restinio_stream_t *s) {
+    return s->state->failed.load();
+}
+
+void restinio_stream_finish(restinio_stream_t *s) {
+    s->rb.done(stream_write_notificator(s));
+    restinio_server_t *server = s->server;
+    delete s;
+    if (server)
+        request_finished(server, true);
+}
+
+restinio_response_builder_t *restinio_response_builder(int status_code) {
+    restinio_response_builder_t *b = acquire_response_builder();
+    b->status_code = status_code;
+    return b;
+}
+
+void restinio_response_builder_header_n(
+    restinio_response_builder_t *b,
+    const char *key, size_t key_length,
+    const char *value, size_t value_length) {
+    restinio_response_builder_t::header_ref_t h;
+    h.key = b->header_data.size();
+    h.key_length = key_length;
+    b->header_data.append(key, key_length);
+    b->header_data.push_back('\0');
+    h.value = b->header_data.size();
+    h.value_length = value_length;
+    b->header_data.append(value, value_length);
+    b->header_data.push_back('\0');
+    b->header_refs.push_back(h);
+}
+
+void restinio_response_builder_header(
+    restinio_response_builder_t *b,
+    const char *key,
+    const char *value) {
+    restinio_response_builder_header_n(b, key, strlen(key), value, strlen(value));
+}
+
+void restinio_response_builder_body(
+    restinio_response_builder_t *b,
+    const void *data,
+    size_t length) {
+    if (b->items.empty() || b->items.back().data || b->items.back().file >= 0)
+        b->items.push_back({NULL, b->body.size(), 0, NULL, NULL, -1});
+    b->items.back().length += length;
+    b->body.append(static_cast<const char *>(data), length);
+}
+
+void restinio_response_builder_body_owned(
+    restinio_response_builder_t *b,
+    const void *data,
+    size_t length,
+    restinio_release_cb release,
+    void *release_arg) {
+    b->items.push_back({static_cast<const char *>(data), 0, length, release, release_arg, -1});
+}
+
+bool restinio_response_builder_file(
+    restinio_response_builder_t *b,
+    const char *path,
+    uint64_t offset,
+    uint64_t length) {
+    try {
+        auto sf = restinio::sendfile(path);
+        if (!length)
+            length = sf.meta().fsize() > offset ? sf.meta().fsize() - offset : 0;
+        b->files.push_back(std::move(sf).offset_and_size(offset, length));
+    } catch (const std::exception &) {
+        return false;
     }
+    b->items.push_back({NULL, 0, static_cast<size_t>(length), NULL, NULL,
+                        static_cast<int>(b->files.size() - 1)});
+    return true;
+}
 
-    auto req = *req_ptr;
+void restinio_response_builder_etag(
+    restinio_response_builder_t *b,
+    const char *etag) {
+    if (!etag) {
+        b->etag_from_body = true;
+        return;
+    }
+    size_t length = strlen(etag);
+    bool quoted = length >= 2 && etag[length - 1] == '"' &&
+                  (etag[0] == '"' || (length > 3 && !strncmp(etag, "W/\"", 3)));
+    if (quoted) {
+        restinio_response_builder_header_n(b, "ETag", 4, etag, length);
+        return;
+    }
+    std::string tag;
+    tag.reserve(length + 2);
+    tag.push_back('"');
+    tag.append(etag, length);
+    tag.push_back('"');
+    restinio_response_builder_header_n(b, "ETag", 4, tag.data(), tag.size());
+}
 
-    // Build and finalize the response
-    auto rb = req->create_response();
-    rb.header().status_code(restinio::http_status_code_t{static_cast<uint16_t>(status_code)});
-    rb.set_body(std::string(response_body, response_body_length));
+restinio_response_t *restinio_response_builder_finish(restinio_response_builder_t *b) {
+    restinio_response_t *r = &b->response;
+    bool ok = b->status_code >= 200 && b->status_code < 300;
 
-    // Apply headers
-    if (headers) {
-        for (auto *hdr = headers; hdr != nullptr; hdr = hdr->next) {
-            if (hdr->key && hdr->value) {
-                rb.header().set_field(hdr->key, hdr->value);
+    if (b->etag_from_body) {
+        // FNV-1a over the in-memory pieces; file slices cannot be hashed here
+        uint64_t h = 14695981039346656037ULL;
+        bool hashable = true;
+        for (const auto &item : b->items) {
+            if (item.file >= 0) {
+                hashable = false;
+                break;
             }
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(
+                item.data ? item.data : b->body.data() + item.offset);
+            for (size_t i = 0; i < item.length; i++) {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+            }
+        }
+        if (hashable) {
+            char tag[24];
+            int n = snprintf(tag, sizeof(tag), "\"%016llx\"", (unsigned long long)h);
+            restinio_response_builder_header_n(b, "ETag", 4, tag, (size_t)n);
         }
+        b->etag_from_body = false;
     }
 
-    rb.done();
+    // fill in the plain restinio_response_t view for code that inspects it;
+    // `response` is only set when the body is a single piece
+    size_t length = 0;
+    for (const auto &item : b->items)
+        length += item.length;
+    r->response = NULL;
+    if (b->items.size() == 1 && b->items[0].file < 0) {
+        const auto &item = b->items[0];
+        r->response = const_cast<char *>(item.data ? item.data : b->body.data() + item.offset);
+    }
+    r->response_length = length;
+    r->error_code = ok ? 0 : b->status_code;
+    r->error_message = ok ? NULL : r->response;
 
-    // Clean up the request pointer
-    delete req_ptr;
+    size_t num_headers = b->header_refs.size();
+    b->header_nodes.resize(num_headers);
+    for (size_t i = 0; i < num_headers; i++) {
+        const auto &h = b->header_refs[i];
+        b->header_nodes[i].key = &b->header_data[h.key];
+        b->header_nodes[i].value = &b->header_data[h.value];
+        b->header_nodes[i].next = i + 1 < num_headers ? &b->header_nodes[i + 1] : NULL;
+    }
+    r->headers = num_headers ? b->header_nodes.data() : NULL;
+    r->destroy = release_response_builder;
+    return r;
 }
 
 void restinio_finish_detached_error(
@@ -252,16 +2538,15 @@ void restinio_finish_detached_json(
     );
 }
 
-static void _restinio_use(const char *method,
-                          const char *path,
-                          restinio_handle_request_cb cb,
-                          restinio_handle_detached_request_cb detached_cb,
-                          void *arg) {
+static restinio_route_t *_restinio_use(restinio_server_t *server,
+                                       const char *method,
+                                       const char *path,
+                                       void *arg) {
     size_t path_length = path ? strlen(path) : 0;
     size_t method_length = method ? strlen(method) : 0;
 
-    restinio_path_handler_t *handler =
-        (restinio_path_handler_t *)calloc(1, sizeof(*handler) + method_length + path_length + 2);
+    restinio_route_t *handler =
+        (restinio_route_t *)calloc(1, sizeof(*handler) + method_length + path_length + 2);
     handler->method = (char *)(handler + 1);
     if(method_length) {
         strcpy(handler->method, method);
@@ -277,34 +2562,400 @@ static void _restinio_use(const char *method,
     else
         handler->path[0] = 0;
 
-    if(!g_path_map)
-        g_path_map = g_path_map_tail = handler;
+    if(!server->routes_head)
+        server->routes_head = server->routes_tail = handler;
     else {
-        g_path_map_tail->next = handler;
-        g_path_map_tail = handler;
+        server->routes_tail->next = handler;
+        server->routes_tail = handler;
     }
-    handler->detached_cb = detached_cb;
-    handler->cb = cb;
     handler->arg = arg;
+    return handler;
+}
+
+restinio_route_t *restinio_server_use(restinio_server_t *server,
+                                      const char *method,
+                                      const char *path,
+                                      restinio_handle_request_cb cb,
+                                      void *arg) {
+    restinio_route_t *route = _restinio_use(server, method, path, arg);
+    route->cb = cb;
+    return route;
+}
+
+restinio_route_t *restinio_use(const char *method,
+                               const char *path,
+                               restinio_handle_request_cb cb,
+                               void *arg) {
+    return restinio_server_use(default_server(), method, path, cb, arg);
+}
+
+restinio_route_t *restinio_server_use_detached(restinio_server_t *server,
+                                               const char *method,
+                                               const char *path,
+                                               restinio_handle_detached_request_cb cb,
+                                               void *arg) {
+    restinio_route_t *route = _restinio_use(server, method, path, arg);
+    route->detached_cb = cb;
+    return route;
+}
+
+restinio_route_t *restinio_use_detached(const char *method,
+                                        const char *path,
+                                        restinio_handle_detached_request_cb cb,
+                                        void *arg) {
+    return restinio_server_use_detached(default_server(), method, path, cb, arg);
+}
+
+restinio_route_t *restinio_server_use_view(restinio_server_t *server,
+                                           const char *method,
+                                           const char *path,
+                                           restinio_handle_request_view_cb cb,
+                                           void *arg) {
+    restinio_route_t *route = _restinio_use(server, method, path, arg);
+    route->view_cb = cb;
+    return route;
+}
+
+restinio_route_t *restinio_use_view(const char *method,
+                                    const char *path,
+                                    restinio_handle_request_view_cb cb,
+                                    void *arg) {
+    return restinio_server_use_view(default_server(), method, path, cb, arg);
+}
+
+restinio_route_t *restinio_server_use_static(restinio_server_t *server,
+                                             const char *method,
+                                             const char *path,
+                                             int status_code,
+                                             const restinio_header_t *headers,
+                                             const void *body,
+                                             size_t body_length) {
+    auto *s = new static_response_t{status_line(status_code), status_code, {},
+                                    std::string(static_cast<const char *>(body), body_length), {}};
+    bool has_etag = false;
+    for (const restinio_header_t *hdr = headers; hdr; hdr = hdr->next) {
+        if (!hdr->key || !hdr->value)
+            continue;
+        s->headers.emplace_back(hdr->key, hdr->value);
+        if (header_is(hdr->key, "ETag")) {
+            has_etag = true;
+            s->etag = hdr->value;
+        }
+    }
+    if (status_code >= 200 && status_code < 300 && !has_etag) {
+        // FNV-1a, as restinio_response_builder_etag(rb, NULL) uses
+        uint64_t h = 14695981039346656037ULL;
+        for (unsigned char c : s->body) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        char tag[24];
+        snprintf(tag, sizeof(tag), "\"%016llx\"", (unsigned long long)h);
+        s->etag = tag;
+        s->headers.emplace_back("ETag", s->etag);
+    } else if (status_code < 200 || status_code >= 300) {
+        s->etag.clear();
+    }
+
+    restinio_route_t *route = _restinio_use(server, method, path, NULL);
+    route->static_response = s;
+    return route;
+}
+
+restinio_route_t *restinio_use_static(const char *method,
+                                      const char *path,
+                                      int status_code,
+                                      const restinio_header_t *headers,
+                                      const void *body,
+                                      size_t body_length) {
+    return restinio_server_use_static(default_server(), method, path, status_code,
+                                      headers, body, body_length);
+}
+
+restinio_route_t *restinio_server_use_detached_view(restinio_server_t *server,
+                                                    const char *method,
+                                                    const char *path,
+                                                    restinio_handle_detached_request_view_cb cb,
+                                                    void *arg) {
+    restinio_route_t *route = _restinio_use(server, method, path, arg);
+    route->detached_view_cb = cb;
+    return route;
+}
+
+restinio_route_t *restinio_use_detached_view(const char *method,
+                                             const char *path,
+                                             restinio_handle_detached_request_view_cb cb,
+                                             void *arg) {
+    return restinio_server_use_detached_view(default_server(), method, path, cb, arg);
+}
+
+void restinio_route_compress(restinio_route_t *route, size_t min_bytes) {
+    route->compress_min_bytes = min_bytes ? min_bytes : 1;
+}
+
+void restinio_route_blocking(restinio_route_t *route) {
+    route->blocking = true;
+}
+
+void restinio_route_deadline(restinio_route_t *route, uint32_t timeout_ms) {
+    route->deadline_ms = timeout_ms;
+}
+
+void restinio_route_on_cancel(restinio_route_t *route, restinio_cancel_cb cb) {
+    route->cancel_cb = cb;
+}
+
+bool restinio_detached_cancelled(const void *response_handle) {
+    auto handle = static_cast<const restinio_request_t *>(response_handle);
+    return handle && handle->state.outcome.load(std::memory_order_acquire) == handle_cancelled;
+}
+
+void restinio_route_max_body_size(restinio_route_t *route, size_t max_bytes) {
+    route->max_body_size = max_bytes;
+}
+
+void restinio_route_body_chunks(restinio_route_t *route, restinio_body_chunk_cb cb) {
+    route->body_chunk_cb = cb;
+}
+
+void restinio_route_cache(restinio_route_t *route,
+                          uint32_t ttl_ms,
+                          size_t max_bytes,
+                          const char *vary) {
+    restinio_response_cache_destroy(route->cache);
+    free(route->cache_vary);
+    route->cache = restinio_response_cache_create(max_bytes ? max_bytes : (16u << 20), ttl_ms);
+    route->cache_vary = nullptr;
+    if (!vary)
+        return;
+
+    // "Accept-Language, X-Tenant" -> "Accept-Language\0X-Tenant\0\0"
+    size_t length = strlen(vary);
+    char *names = (char *)calloc(1, length + 2);
+    if (!names)
+        return;
+    char *out = names;
+    for (const char *p = vary; *p;) {
+        p += strspn(p, ", \t");
+        size_t n = strcspn(p, ",");
+        while (n && (p[n - 1] == ' ' || p[n - 1] == '\t'))
+            n--;
+        if (n) {
+            memcpy(out, p, n);
+            out += n + 1;
+        }
+        p += strcspn(p, ",");
+    }
+    route->cache_vary = names;
+}
+
+bool restinio_route_cache_stats(const restinio_route_t *route, restinio_cache_stats_t *stats) {
+    if (!route->cache) {
+        *stats = restinio_cache_stats_t{};
+        return false;
+    }
+    restinio_response_cache_stats(route->cache, stats);
+    return true;
+}
+
+const char *restinio_request_method(const restinio_request_t *req, size_t *length) {
+    const char *method = req->req->header().method().c_str();
+    if (length)
+        *length = strlen(method);
+    return method;
+}
+
+const char *restinio_request_target(const restinio_request_t *req, size_t *length) {
+    const std::string &target = req->req->header().request_target();
+    if (length)
+        *length = target.size();
+    return target.c_str();
+}
+
+const char *restinio_request_body(const restinio_request_t *req, size_t *length) {
+    const std::string &body = req->req->body();
+    if (length)
+        *length = body.size();
+    return body.data();
+}
+
+size_t restinio_request_header_count(const restinio_request_t *req) {
+    return req->req->header().fields_count();
+}
+
+bool restinio_request_header_at(
+    const restinio_request_t *req,
+    size_t index,
+    const char **name, size_t *name_length,
+    const char **value, size_t *value_length) {
+    const auto &fields = req->req->header();
+    if (index >= fields.fields_count())
+        return false;
+
+    const auto &field = *(fields.begin() + index);
+    if (name)
+        *name = field.name().c_str();
+    if (name_length)
+        *name_length = field.name().size();
+    if (value)
+        *value = field.value().c_str();
+    if (value_length)
+        *value_length = field.value().size();
+    return true;
+}
+
+restinio_server_t *restinio_server_create_ex(const restinio_options_t *options,
+                                             size_t options_size) {
+    restinio_server_t *server = new restinio_server_t();
+    set_options(server, options, options_size);
+    server->stopped = true;
+    return server;
+}
+
+// Entry point for callers built before options were versioned
+restinio_server_t *(restinio_server_create)(const restinio_options_t *options) {
+    return restinio_server_create_ex(options, legacy_options_size);
+}
+
+bool restinio_server_run(restinio_server_t *server) {
+    if (!server->stopped) {
+        std::cerr << "restinio_server_run called on a running server\n";
+        return false;
+    }
+    freeze_routes(server);
+    server->running.reset();
+    server->running_tls.reset();
+    server->shards.clear();
+    return start_server(server);
+}
+
+void restinio_server_stop(restinio_server_t *server) {
+    if (server->stopped)
+        return;
+    if (server->running) {
+        server->running->stop();
+        server->running->wait();
+    }
+    if (server->running_tls) {
+        server->running_tls->stop();
+        server->running_tls->wait();
+    }
+    close_completions(&server->completions);
+    stop_shards(server);
+    server->stopped = true;
+}
+
+bool restinio_server_drain(restinio_server_t *server, uint32_t timeout_ms) {
+    if (server->stopped)
+        return true;
+
+    server->draining = true;
+    bool drained;
+    {
+        std::unique_lock<std::mutex> lock(server->drain_mutex);
+        drained = server->drained.wait_for(
+            lock, std::chrono::milliseconds(timeout_ms),
+            [server] { return server->in_flight.load() == 0; });
+    }
+    // blocking requests that never reached a worker are answered while the
+    // I/O threads can still send
+    if (!drained && server->workers)
+        restinio_worker_pool_cancel(server->workers, cancel_blocking);
+    restinio_server_stop(server);
+    server->draining = false;
+    return drained;
+}
+
+bool restinio_server_reload_tls(restinio_server_t *server) {
+    if (!server->tls) {
+        std::cerr << "restinio_server_reload_tls: TLS is not running\n";
+        return false;
+    }
+    SSL_CTX *certificate = load_certificate(server->options);
+    if (!certificate)
+        return false;
+    std::lock_guard<std::mutex> lock(server->tls_mutex);
+    SSL_CTX_free(server->tls_certificate);  // handshakes in progress hold a reference
+    server->tls_certificate = certificate;
+    return true;
 }
 
-void restinio_use(const char *method,
-                  const char *path,
-                  restinio_handle_request_cb cb,
-                  void *arg) {
-    _restinio_use(method, path, cb, NULL, arg);
+bool restinio_route_metrics(const restinio_route_t *route, restinio_route_metrics_t *metrics) {
+    restinio_server_t *server = route->server;
+    if (!server || !server->metrics || route->index >= restinio_metrics_slots(server->metrics)) {
+        *metrics = restinio_route_metrics_t{};
+        return false;
+    }
+    restinio_metrics_read(server->metrics, route->index, metrics);
+    return true;
+}
+
+void restinio_server_metrics(const restinio_server_t *server, restinio_server_metrics_t *metrics) {
+    metrics->in_flight = restinio_server_in_flight(server, &metrics->detached);
+    metrics->unrouted = server->unrouted.load(std::memory_order_relaxed);
+    metrics->rejected_overload = server->rejected_overload.load(std::memory_order_relaxed);
+    metrics->rejected_draining = server->rejected_draining.load(std::memory_order_relaxed);
+    metrics->access_log_dropped = server->access_log
+        ? restinio_access_log_dropped(server->access_log) : 0;
+}
+
+restinio_route_t *restinio_server_use_metrics(restinio_server_t *server, const char *path) {
+    server->options.enable_metrics = true;
+    return restinio_server_use_view(server, "GET", path, metrics_handler, server);
+}
+
+bool restinio_server_worker_stats(const restinio_server_t *server,
+                                  restinio_worker_stats_t *stats) {
+    *stats = restinio_worker_stats_t{};
+    if (!server->workers)
+        return false;
+    restinio_worker_pool_stats_t pool;
+    restinio_worker_pool_stats(server->workers, &pool);
+    stats->threads = pool.threads;
+    stats->queued = pool.queued;
+    stats->running = pool.running;
+    stats->completed = pool.completed;
+    stats->rejected = pool.rejected;
+    stats->wait_us_total = pool.wait_us_total;
+    stats->wait_us_max = pool.wait_us_max;
+    return true;
+}
+
+size_t restinio_server_in_flight(const restinio_server_t *server, size_t *detached) {
+    if (detached)
+        *detached = server->detached.load();
+    return server->in_flight.load();
 }
 
-void restinio_use_detached(const char *method,
-                           const char *path,
-                           restinio_handle_detached_request_cb cb,
-                           void *arg) {
-    _restinio_use(method, path, NULL, cb, arg);
+void restinio_server_destroy(restinio_server_t *server) {
+    if (!server)
+        return;
+    restinio_server_stop(server);
+    // queued blocking requests still run and send into closed connections
+    restinio_worker_pool_destroy(server->workers);
+    server->running.reset();
+    server->running_tls.reset();
+    server->shards.clear();
+    SSL_CTX_free(server->tls_certificate);
+    restinio_metrics_destroy(server->metrics);
+    restinio_access_log_close(server->access_log);
+
+    restinio_route_table_destroy(server->route_table);
+    restinio_route_t *handler = server->routes_head;
+    while(handler) {
+        restinio_route_t *next = handler->next;
+        delete handler->static_response;
+        restinio_response_cache_destroy(handler->cache);
+        free(handler->cache_vary);
+        free(handler);
+        handler = next;
+    }
+    delete server;
 }
 
-void restinio_init(restinio_options_t *options)
+void restinio_init_ex(const restinio_options_t *options, size_t options_size)
 {
-    if (g_server) {
+    if (g_default_initialized) {
         std::cerr << "restinio_init called twice?\n";
         return;
     }
@@ -314,41 +2965,149 @@ void restinio_init(restinio_options_t *options)
         return;
     }
 
-    g_options = *options;
-    g_server = std::make_unique<ServerInstance>();
+    set_options(default_server(), options, options_size);
+    g_default_initialized = true;
+}
+
+// Entry point for callers built before options were versioned
+void (restinio_init)(restinio_options_t *options)
+{
+    restinio_init_ex(options, legacy_options_size);
 }
 
 void restinio_run() {
-    // Pass `g_options` by value to avoid capturing a global variable by reference
-    g_server->server_thread = std::make_unique<std::thread>([options = g_options]() {
-        run_server_loop(options);
-    });
+    if (!g_default_initialized) {
+        std::cerr << "restinio_run called but not initted?\n";
+        return;
+    }
+    restinio_server_run(g_default_server);
 }
 
 
+bool restinio_drain(uint32_t timeout_ms) {
+    if (!g_default_initialized) {
+        std::cerr << "restinio_drain called but not initted?\n";
+        return false;
+    }
+    return restinio_server_drain(g_default_server, timeout_ms);
+}
+
 void restinio_destroy()
 {
-    if (!g_server) {
+    if (!g_default_initialized) {
         std::cerr << "restinio_destroy called but not initted?\n";
         return;
     }
-    g_stop_flag.store(true);
+    restinio_server_destroy(g_default_server);
+    g_default_server = NULL;
+    g_default_initialized = false;
+}
 
-    // Wait for server thread to finish
-    if (g_server->server_thread && g_server->server_thread->joinable()) {
-        g_server->server_thread->join();
-    }
+const char *restinio_request_header(
+    const restinio_request_t *req,
+    const char *name,
+    size_t *length) {
+    const std::string *value =
+        req->req->header().try_get_field(restinio::string_view_t{name, strlen(name)});
+    if (!value)
+        return NULL;
+    if (length)
+        *length = value->size();
+    return value->c_str();
+}
 
-    restinio_path_handler_t *handler = g_path_map;
-    while(handler) {
-        restinio_path_handler_t *next = handler->next;
-        free(handler);
-        handler = next;
-    }
-    g_path_map = g_path_map_tail = NULL;
+bool restinio_request_etag_matches(
+    const restinio_request_t *req,
+    const char *etag) {
+    const std::string *condition = request_field(req, "If-None-Match");
+    return condition && if_none_match(*condition, restinio::string_view_t{etag});
+}
 
-    // Clean up resources
-    g_server.reset();
+bool restinio_request_accepts_encoding(
+    const restinio_request_t *req,
+    const char *coding) {
+    const std::string *value =
+        req->req->header().try_get_field(restinio::string_view_t{"Accept-Encoding", 15});
+    if (!value)
+        return !strcasecmp(coding, "identity");
+    return restinio_http_accepts_encoding(value->data(), value->size(), coding);
+}
+
+size_t restinio_request_query_count(const restinio_request_t *req) {
+    return request_query(req).size();
+}
+
+bool restinio_request_query_at(
+    const restinio_request_t *req,
+    size_t index,
+    const char **name, size_t *name_length,
+    const char **value, size_t *value_length) {
+    const auto &query = request_query(req);
+    if (index >= query.size())
+        return false;
+
+    const auto &param = *(query.begin() + index);
+    if (name)
+        *name = param.first.data();
+    if (name_length)
+        *name_length = param.first.size();
+    if (value)
+        *value = param.second.data();
+    if (value_length)
+        *value_length = param.second.size();
+    return true;
+}
+
+const char *restinio_request_query(
+    const restinio_request_t *req,
+    const char *name,
+    size_t *length) {
+    auto value = request_query(req).get_param(restinio::string_view_t{name, strlen(name)});
+    if (!value)
+        return NULL;
+    if (length)
+        *length = value->size();
+    return value->data();
+}
+
+size_t restinio_request_path_param_count(const restinio_request_t *req) {
+    return req->num_params;
+}
+
+bool restinio_request_path_param_at(
+    const restinio_request_t *req,
+    size_t index,
+    const char **name, size_t *name_length,
+    const char **value, size_t *value_length) {
+    if (index >= req->num_params)
+        return false;
+
+    const restinio_route_param_t *param = req->params + index;
+    if (name)
+        *name = param->name;
+    if (name_length)
+        *name_length = param->name_length;
+    if (value)
+        *value = param->value;
+    if (value_length)
+        *value_length = param->value_length;
+    return true;
+}
+
+const char *restinio_request_path_param(
+    const restinio_request_t *req,
+    const char *name,
+    size_t *length) {
+    size_t name_length = strlen(name);
+    for (size_t i = 0; i < req->num_params; i++) {
+        const restinio_route_param_t *param = req->params + i;
+        if (param->name_length == name_length && !memcmp(param->name, name, name_length)) {
+            if (length)
+                *length = param->value_length;
+            return param->value;
+        }
+    }
+    return NULL;
 }
 
 #ifdef __cplusplus
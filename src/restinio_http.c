@@ -0,0 +1,225 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#include "restinio_http.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+// true if a q-value (the text after "q=") is zero
+static bool qvalue_is_zero(const char *p, const char *end) {
+    if (p == end || *p != '0')
+        return false;
+    p++;
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (*p != '0')
+                return false;
+        }
+    }
+    return true;
+}
+
+bool restinio_http_accepts_encoding(const char *header, size_t header_length,
+                                    const char *coding) {
+    size_t coding_length = strlen(coding);
+    int explicit_q = -1, wildcard_q = -1;   // -1 unseen, 0 refused, 1 accepted
+
+    const char *p = header, *end = header + header_length;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ','))
+            p++;
+        const char *token = p;
+        while (p < end && *p != ',' && *p != ';' && *p != ' ' && *p != '\t')
+            p++;
+        size_t token_length = (size_t)(p - token);
+
+        int q = 1;
+        while (p < end && *p != ',') {
+            if (*p == ';') {
+                p++;
+                while (p < end && (*p == ' ' || *p == '\t'))
+                    p++;
+                if (end - p > 2 && (p[0] == 'q' || p[0] == 'Q') && p[1] == '=') {
+                    const char *v = p + 2, *v_end = v;
+                    while (v_end < end && *v_end != ',' && *v_end != ';' && *v_end != ' ')
+                        v_end++;
+                    q = qvalue_is_zero(v, v_end) ? 0 : 1;
+                    p = v_end;
+                    continue;
+                }
+            }
+            p++;
+        }
+
+        if (token_length == coding_length && !strncasecmp(token, coding, coding_length))
+            explicit_q = q;
+        else if (token_length == 1 && *token == '*')
+            wildcard_q = q;
+    }
+
+    if (explicit_q >= 0)
+        return explicit_q > 0;
+    if (wildcard_q >= 0)
+        return wildcard_q > 0;
+    return !strcasecmp(coding, "identity");
+}
+
+typedef struct {
+    const char *data;
+    size_t length;
+} token_t;
+
+// the opaque part of an entity-tag: W/ and the quotes are dropped
+static token_t opaque_tag(token_t tag) {
+    if (tag.length >= 2 && tag.data[0] == 'W' && tag.data[1] == '/') {
+        tag.data += 2;
+        tag.length -= 2;
+    }
+    if (tag.length >= 2 && tag.data[0] == '"' && tag.data[tag.length - 1] == '"') {
+        tag.data++;
+        tag.length -= 2;
+    }
+    return tag;
+}
+
+bool restinio_http_etag_matches(const char *header, size_t header_length,
+                                const char *etag, size_t etag_length) {
+    token_t wanted = opaque_tag((token_t){etag, etag_length});
+    size_t pos = 0;
+    while (pos < header_length) {
+        while (pos < header_length && (header[pos] == ' ' || header[pos] == '\t' || header[pos] == ','))
+            pos++;
+        size_t start = pos;
+        bool quoted = false;
+        while (pos < header_length && (quoted || header[pos] != ',')) {
+            if (header[pos] == '"')
+                quoted = !quoted;
+            pos++;
+        }
+        token_t tag = {header + start, pos - start};
+        while (tag.length && (tag.data[tag.length - 1] == ' ' || tag.data[tag.length - 1] == '\t'))
+            tag.length--;
+        if (tag.length == 1 && tag.data[0] == '*')
+            return true;
+        if (tag.length) {
+            token_t opaque = opaque_tag(tag);
+            if (opaque.length == wanted.length && !memcmp(opaque.data, wanted.data, wanted.length))
+                return true;
+        }
+    }
+    return false;
+}
+
+void restinio_http_format_date(time_t t, char *buf, size_t size) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(buf, size, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+bool restinio_http_parse_date(const char *s, time_t *out) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char month[4];
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(s, "%*3s, %2d %3s %4d %2d:%2d:%2d GMT",
+               &tm.tm_mday, month, &tm.tm_year, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+        return false;
+    const char *m = strstr(months, month);
+    if (!m || strlen(month) != 3 || (m - months) % 3)
+        return false;
+    tm.tm_mon = (int)(m - months) / 3;
+    tm.tm_year -= 1900;
+    *out = timegm(&tm);
+    return true;
+}
+
+static bool parse_uint64(const char **p, uint64_t *out) {
+    const char *s = *p;
+    if (*s < '0' || *s > '9')
+        return false;
+    uint64_t v = 0;
+    for (; *s >= '0' && *s <= '9'; s++) {
+        if (v > (UINT64_MAX - 9) / 10)
+            return false;
+        v = v * 10 + (uint64_t)(*s - '0');
+    }
+    *p = s;
+    *out = v;
+    return true;
+}
+
+int restinio_http_parse_ranges(const char *header, uint64_t size,
+                               restinio_byte_range_t *ranges) {
+    if (strncasecmp(header, "bytes=", 6))
+        return -1;
+    const char *p = header + 6;
+    int num_ranges = 0, num_specs = 0;
+    for (;;) {
+        while (*p == ' ' || *p == '\t')
+            p++;
+        uint64_t first, last;
+        bool satisfiable;
+        if (*p == '-') {
+            // suffix range: the last n bytes
+            p++;
+            uint64_t n;
+            if (!parse_uint64(&p, &n))
+                return -1;
+            satisfiable = n > 0 && size > 0;
+            first = n >= size ? 0 : size - n;
+            last = size - 1;
+        } else {
+            if (!parse_uint64(&p, &first) || *p++ != '-')
+                return -1;
+            last = UINT64_MAX;
+            if (*p >= '0' && *p <= '9') {
+                if (!parse_uint64(&p, &last) || last < first)
+                    return -1;
+            }
+            satisfiable = first < size;
+            if (last >= size)
+                last = size - 1;
+        }
+        if (++num_specs > RESTINIO_HTTP_MAX_RANGES)
+            return -1;
+        if (satisfiable) {
+            ranges[num_ranges].first = first;
+            ranges[num_ranges].last = last;
+            num_ranges++;
+        }
+
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (!*p)
+            return num_ranges;
+        if (*p++ != ',')
+            return -1;
+    }
+}
+
+bool restinio_http_if_range_matches(const char *if_range, const char *etag,
+                                    time_t modified) {
+    if (if_range[0] == '"' || !strncmp(if_range, "W/", 2))
+        return !strcmp(if_range, etag);
+    time_t t;
+    return restinio_http_parse_date(if_range, &t) && t == modified;
+}
+
+size_t restinio_http_range_part(char *buf, size_t size, const char *boundary,
+                                const char *content_type,
+                                const restinio_byte_range_t *range,
+                                uint64_t total, bool first) {
+    int n = range
+        ? snprintf(buf, size,
+                   "%s--%s\r\nContent-Type: %s\r\nContent-Range: bytes %llu-%llu/%llu\r\n\r\n",
+                   first ? "" : "\r\n", boundary, content_type,
+                   (unsigned long long)range->first, (unsigned long long)range->last,
+                   (unsigned long long)total)
+        : snprintf(buf, size, "\r\n--%s--\r\n", boundary);
+    if (n < 0 || !size)
+        return 0;
+    return (size_t)n < size ? (size_t)n : size - 1;
+}
@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef _RESTINIO_HTTP_H
+#define _RESTINIO_HTTP_H
+
+/*
+ * Internal: parsers for the request headers the server and the path handler
+ * negotiate on.  They work on plain strings, so they can be tested without
+ * a connection.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Accept-Encoding negotiation (RFC 9110 12.5.3): an explicit entry wins over
+// "*", and q=0 rules a coding out.  identity is acceptable unless excluded.
+bool restinio_http_accepts_encoding(const char *header, size_t header_length,
+                                    const char *coding);
+
+// If-None-Match uses the weak comparison (RFC 9110 13.1.2): any listed tag
+// with the same opaque part as etag matches, and so does "*"
+bool restinio_http_etag_matches(const char *header, size_t header_length,
+                                const char *etag, size_t etag_length);
+
+// Formats t as an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT")
+void restinio_http_format_date(time_t t, char *buf, size_t size);
+
+// Parses an IMF-fixdate; the obsolete formats are not accepted and read as
+// no condition at all
+bool restinio_http_parse_date(const char *s, time_t *out);
+
+#define RESTINIO_HTTP_MAX_RANGES 16     // longer Range lists are ignored
+
+typedef struct {
+    uint64_t first, last;   // inclusive
+} restinio_byte_range_t;
+
+// Parses "bytes=0-99, 200-, -50" against a representation of size bytes
+// into ranges (room for RESTINIO_HTTP_MAX_RANGES).  Returns the number of
+// satisfiable ranges (0 means 416), or -1 when the header is malformed or
+// too long and the whole representation should be sent.
+int restinio_http_parse_ranges(const char *header, uint64_t size,
+                               restinio_byte_range_t *ranges);
+
+// If-Range holds either the strong ETag or the exact Last-Modified date
+// (RFC 9110 13.1.5); false means the client's copy is stale
+bool restinio_http_if_range_matches(const char *if_range, const char *etag,
+                                    time_t modified);
+
+// Writes the multipart/byteranges delimiter and part headers that go before
+// range (the first part has no leading CRLF), or with range NULL the closing
+// delimiter.  Returns the length written, truncated to fit size.
+size_t restinio_http_range_part(char *buf, size_t size, const char *boundary,
+                                const char *content_type,
+                                const restinio_byte_range_t *range,
+                                uint64_t total, bool first);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,164 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#include "restinio_metrics.h"
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRIPES 16
+#define SUB_BUCKET_BITS 2
+#define SUB_BUCKETS (1u << SUB_BUCKET_BITS)
+
+typedef struct {
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t sum_us;
+    atomic_uint_fast64_t max_us;
+    atomic_uint_fast64_t buckets[RESTINIO_HISTOGRAM_BUCKETS];
+} histogram_t;
+
+typedef struct {
+    _Alignas(64) atomic_uint_fast64_t status[6];
+    atomic_uint_fast64_t bytes_in;
+    atomic_uint_fast64_t bytes_out;
+    histogram_t queue, handler, total;
+} stripe_t;
+
+struct restinio_metrics_s {
+    size_t num_slots;
+    stripe_t *stripes;      // num_slots * STRIPES
+};
+
+static atomic_uint next_stripe;
+static _Thread_local unsigned thread_stripe = UINT_MAX;
+
+static size_t bucket_of(uint64_t us) {
+    if (us < SUB_BUCKETS)
+        return (size_t)us;
+    unsigned exponent = 63u - (unsigned)__builtin_clzll(us);
+    size_t bucket = SUB_BUCKETS * (exponent - SUB_BUCKET_BITS + 1) +
+                    ((us >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return bucket < RESTINIO_HISTOGRAM_BUCKETS ? bucket : RESTINIO_HISTOGRAM_BUCKETS - 1;
+}
+
+uint64_t restinio_histogram_bucket_high(size_t bucket) {
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    if (bucket >= RESTINIO_HISTOGRAM_BUCKETS - 1)
+        return UINT64_MAX;
+    unsigned shift = (unsigned)(bucket / SUB_BUCKETS) - 1;
+    uint64_t low = (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return low + ((uint64_t)1 << shift) - 1;
+}
+
+uint64_t restinio_histogram_percentile(const restinio_histogram_t *h, double percentile) {
+    if (!h->count)
+        return 0;
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)h->count);
+    if (rank >= h->count)
+        rank = h->count - 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < RESTINIO_HISTOGRAM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > rank) {
+            uint64_t high = restinio_histogram_bucket_high(i);
+            return high < h->max_us ? high : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+restinio_metrics_t *restinio_metrics_create(size_t num_slots) {
+    restinio_metrics_t *metrics = (restinio_metrics_t *)calloc(1, sizeof(*metrics));
+    if (!metrics)
+        return NULL;
+    size_t size = (num_slots ? num_slots : 1) * STRIPES * sizeof(stripe_t);
+    metrics->stripes = (stripe_t *)aligned_alloc(_Alignof(stripe_t), size);
+    if (!metrics->stripes) {
+        free(metrics);
+        return NULL;
+    }
+    memset(metrics->stripes, 0, size);
+    metrics->num_slots = num_slots;
+    return metrics;
+}
+
+void restinio_metrics_destroy(restinio_metrics_t *metrics) {
+    if (!metrics)
+        return;
+    free(metrics->stripes);
+    free(metrics);
+}
+
+size_t restinio_metrics_slots(const restinio_metrics_t *metrics) {
+    return metrics->num_slots;
+}
+
+static void add(atomic_uint_fast64_t *counter, uint64_t value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+static void histogram_record(histogram_t *h, uint64_t us) {
+    add(&h->count, 1);
+    add(&h->sum_us, us);
+    add(&h->buckets[bucket_of(us)], 1);
+    uint_fast64_t max = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+    while (us > max && !atomic_compare_exchange_weak_explicit(
+               &h->max_us, &max, us, memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+void restinio_metrics_record(restinio_metrics_t *metrics,
+                             size_t slot,
+                             int status,
+                             uint64_t bytes_in,
+                             uint64_t bytes_out,
+                             uint64_t queue_us,
+                             uint64_t handler_us,
+                             uint64_t total_us) {
+    if (thread_stripe == UINT_MAX)
+        thread_stripe = atomic_fetch_add(&next_stripe, 1) % STRIPES;
+    stripe_t *s = &metrics->stripes[slot * STRIPES + thread_stripe];
+
+    add(&s->status[status >= 100 && status < 600 ? status / 100 : 0], 1);
+    add(&s->bytes_in, bytes_in);
+    add(&s->bytes_out, bytes_out);
+    histogram_record(&s->queue, queue_us);
+    histogram_record(&s->handler, handler_us);
+    histogram_record(&s->total, total_us);
+}
+
+static uint64_t load(const atomic_uint_fast64_t *counter) {
+    return atomic_load_explicit((atomic_uint_fast64_t *)counter, memory_order_relaxed);
+}
+
+static void histogram_merge(restinio_histogram_t *out, const histogram_t *h) {
+    out->count += load(&h->count);
+    out->sum_us += load(&h->sum_us);
+    uint64_t max = load(&h->max_us);
+    if (max > out->max_us)
+        out->max_us = max;
+    for (size_t i = 0; i < RESTINIO_HISTOGRAM_BUCKETS; i++)
+        out->buckets[i] += load(&h->buckets[i]);
+}
+
+void restinio_metrics_read(const restinio_metrics_t *metrics,
+                           size_t slot,
+                           restinio_route_metrics_t *out) {
+    memset(out, 0, sizeof(*out));
+    for (size_t i = 0; i < STRIPES; i++) {
+        const stripe_t *s = &metrics->stripes[slot * STRIPES + i];
+        for (size_t j = 0; j < 6; j++)
+            out->status[j] += load(&s->status[j]);
+        out->bytes_in += load(&s->bytes_in);
+        out->bytes_out += load(&s->bytes_out);
+        histogram_merge(&out->queue, &s->queue);
+        histogram_merge(&out->handler, &s->handler);
+        histogram_merge(&out->total, &s->total);
+    }
+    for (size_t j = 0; j < 6; j++)
+        out->requests += out->status[j];
+}
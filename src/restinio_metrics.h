@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef _RESTINIO_METRICS_H
+#define _RESTINIO_METRICS_H
+
+/*
+ * Internal: per-route request counters and latency histograms.
+ *
+ * Every route has a fixed number of cache-line aligned stripes and each
+ * thread sticks to one of them, so recording is a handful of relaxed atomic
+ * adds on memory no other thread is likely to touch.  Reading merges the
+ * stripes.  Histograms are log-linear (four sub-buckets per power of two of
+ * microseconds), the same shape HdrHistogram uses at two bits of precision.
+ */
+
+#include "restinio-c/restinio_c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct restinio_metrics_s restinio_metrics_t;
+
+// one slot per route
+restinio_metrics_t *restinio_metrics_create(size_t num_slots);
+
+void restinio_metrics_destroy(restinio_metrics_t *metrics);
+
+size_t restinio_metrics_slots(const restinio_metrics_t *metrics);
+
+void restinio_metrics_record(restinio_metrics_t *metrics,
+                             size_t slot,
+                             int status,
+                             uint64_t bytes_in,
+                             uint64_t bytes_out,
+                             uint64_t queue_us,
+                             uint64_t handler_us,
+                             uint64_t total_us);
+
+void restinio_metrics_read(const restinio_metrics_t *metrics,
+                           size_t slot,
+                           restinio_route_metrics_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,447 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#include "restinio_response_cache.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define SHARDS 16
+#define SHARD_BITS 4
+
+// An immutable response.  The cache holds one reference while the entry is
+// stored; the leader and every response still being written hold others.
+typedef struct cache_entry_s {
+    restinio_cached_response_t response;    // first: handed out as the entry
+    atomic_int refs;
+    uint64_t hash;
+    uint64_t expires_ms;                    // 0: never
+    uint64_t last_used_ms;                  // orders shard tails for eviction
+    size_t size;                            // charged against the cache's budget
+    size_t key_length;
+    const char *key;
+    struct cache_entry_s *prev, *next;      // LRU list, most recent first
+    struct cache_entry_s *bucket_next;
+    char data[];                            // key, headers, body
+} cache_entry_t;
+
+// A miss whose leader is still running the handler
+struct restinio_cache_pending_s {
+    uint64_t hash;
+    size_t key_length;
+    void **waiters;
+    size_t num_waiters, waiters_size;
+    struct restinio_cache_pending_s *next;
+    char key[];
+};
+
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    cache_entry_t **buckets;
+    size_t num_buckets, num_entries;
+    cache_entry_t *head, *tail;
+    size_t bytes;
+    restinio_cache_pending_t *pending;      // a handful at a time
+    uint64_t hits, misses, coalesced, stores, evictions, expirations;
+} cache_shard_t;
+
+struct restinio_response_cache_s {
+    size_t max_bytes;
+    atomic_size_t bytes;                    // the sum of the shards' bytes
+    uint32_t ttl_ms;
+    cache_shard_t shards[SHARDS];
+};
+
+static uint64_t hash_bytes(const void *p, size_t len)
+{
+    // FNV-1a
+    const unsigned char *s = (const unsigned char *)p;
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// the top bits pick the shard, the low ones the bucket
+static cache_shard_t *shard_of(restinio_response_cache_t *cache, uint64_t hash)
+{
+    return cache->shards + (hash >> (64 - SHARD_BITS));
+}
+
+static bool same_key(uint64_t hash, const char *key, size_t key_length,
+                     uint64_t other_hash, const char *other_key, size_t other_length)
+{
+    return hash == other_hash && key_length == other_length && !memcmp(key, other_key, key_length);
+}
+
+restinio_response_cache_t *restinio_response_cache_create(size_t max_bytes, uint32_t ttl_ms)
+{
+    restinio_response_cache_t *cache =
+        (restinio_response_cache_t *)aligned_alloc(_Alignof(restinio_response_cache_t),
+                                                   sizeof(restinio_response_cache_t));
+    if (!cache)
+        return NULL;
+    memset(cache, 0, sizeof(*cache));
+    cache->max_bytes = max_bytes;
+    atomic_init(&cache->bytes, 0);
+    cache->ttl_ms = ttl_ms;
+    for (size_t i = 0; i < SHARDS; i++)
+        pthread_mutex_init(&cache->shards[i].lock, NULL);
+    return cache;
+}
+
+void restinio_cached_response_retain(const restinio_cached_response_t *response)
+{
+    cache_entry_t *entry = (cache_entry_t *)response;
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+}
+
+void restinio_cached_response_release(const restinio_cached_response_t *response)
+{
+    cache_entry_t *entry = (cache_entry_t *)response;
+    if (atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) == 1)
+        free(entry);
+}
+
+static void lru_unlink(cache_shard_t *shard, cache_entry_t *entry)
+{
+    if (entry->prev) entry->prev->next = entry->next;
+    else shard->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else shard->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void lru_push_front(cache_shard_t *shard, cache_entry_t *entry)
+{
+    entry->prev = NULL;
+    entry->next = shard->head;
+    if (shard->head) shard->head->prev = entry;
+    else shard->tail = entry;
+    shard->head = entry;
+}
+
+// caller holds the lock; drops the cache's reference
+static void shard_remove(restinio_response_cache_t *cache, cache_shard_t *shard,
+                         cache_entry_t *entry)
+{
+    cache_entry_t **pp = &shard->buckets[entry->hash & (shard->num_buckets - 1)];
+    while (*pp != entry)
+        pp = &(*pp)->bucket_next;
+    *pp = entry->bucket_next;
+    lru_unlink(shard, entry);
+    shard->bytes -= entry->size;
+    atomic_fetch_sub_explicit(&cache->bytes, entry->size, memory_order_relaxed);
+    shard->num_entries--;
+    restinio_cached_response_release(&entry->response);
+}
+
+// caller holds the lock
+static cache_entry_t *shard_find(cache_shard_t *shard, const char *key, size_t key_length,
+                                 uint64_t hash)
+{
+    if (!shard->num_buckets)
+        return NULL;
+    cache_entry_t *entry = shard->buckets[hash & (shard->num_buckets - 1)];
+    while (entry && !same_key(hash, key, key_length, entry->hash, entry->key, entry->key_length))
+        entry = entry->bucket_next;
+    return entry;
+}
+
+// caller holds the lock; false if the table could not grow.  The budget is
+// enforced afterwards by cache_trim.
+static bool shard_insert(restinio_response_cache_t *cache, cache_shard_t *shard,
+                         cache_entry_t *entry)
+{
+    if (shard->num_entries >= shard->num_buckets) {
+        size_t num_buckets = shard->num_buckets ? shard->num_buckets * 2 : 16;
+        cache_entry_t **buckets = (cache_entry_t **)calloc(num_buckets, sizeof(cache_entry_t *));
+        if (!buckets)
+            return false;
+        for (size_t i = 0; i < shard->num_buckets; i++) {
+            cache_entry_t *e = shard->buckets[i];
+            while (e) {
+                cache_entry_t *next = e->bucket_next;
+                e->bucket_next = buckets[e->hash & (num_buckets - 1)];
+                buckets[e->hash & (num_buckets - 1)] = e;
+                e = next;
+            }
+        }
+        free(shard->buckets);
+        shard->buckets = buckets;
+        shard->num_buckets = num_buckets;
+    }
+
+    entry->bucket_next = shard->buckets[entry->hash & (shard->num_buckets - 1)];
+    shard->buckets[entry->hash & (shard->num_buckets - 1)] = entry;
+    lru_push_front(shard, entry);
+    shard->bytes += entry->size;
+    atomic_fetch_add_explicit(&cache->bytes, entry->size, memory_order_relaxed);
+    shard->num_entries++;
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+    return true;
+}
+
+// Evicts the least recently used entry across all shards until the cache
+// is back within max_bytes.  Holds one shard's lock at a time, so a
+// concurrent insert may leave it slightly over until the next trim.
+static void cache_trim(restinio_response_cache_t *cache)
+{
+    while (atomic_load_explicit(&cache->bytes, memory_order_relaxed) > cache->max_bytes) {
+        cache_shard_t *oldest = NULL;
+        uint64_t oldest_ms = UINT64_MAX;
+        for (size_t i = 0; i < SHARDS; i++) {
+            cache_shard_t *shard = cache->shards + i;
+            pthread_mutex_lock(&shard->lock);
+            if (shard->tail && shard->tail->last_used_ms <= oldest_ms) {
+                oldest = shard;
+                oldest_ms = shard->tail->last_used_ms;
+            }
+            pthread_mutex_unlock(&shard->lock);
+        }
+        if (!oldest)
+            return;
+        pthread_mutex_lock(&oldest->lock);
+        if (oldest->tail) {
+            shard_remove(cache, oldest, oldest->tail);
+            oldest->evictions++;
+        }
+        pthread_mutex_unlock(&oldest->lock);
+    }
+}
+
+restinio_cache_result_t restinio_response_cache_lookup(
+    restinio_response_cache_t *cache,
+    const char *key, size_t key_length,
+    void *(*make_waiter)(void *waiter_arg), void *waiter_arg,
+    const restinio_cached_response_t **out,
+    restinio_cache_pending_t **pending)
+{
+    uint64_t hash = hash_bytes(key, key_length);
+    cache_shard_t *shard = shard_of(cache, hash);
+    *out = NULL;
+    *pending = NULL;
+
+    pthread_mutex_lock(&shard->lock);
+    cache_entry_t *entry = shard_find(shard, key, key_length, hash);
+    if (entry && entry->expires_ms && now_ms() >= entry->expires_ms) {
+        shard_remove(cache, shard, entry);
+        shard->expirations++;
+        entry = NULL;
+    }
+    if (entry) {
+        atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+        entry->last_used_ms = now_ms();
+        lru_unlink(shard, entry);
+        lru_push_front(shard, entry);
+        shard->hits++;
+        pthread_mutex_unlock(&shard->lock);
+        *out = &entry->response;
+        return RESTINIO_CACHE_HIT;
+    }
+
+    restinio_cache_pending_t *p = shard->pending;
+    while (p && !same_key(hash, key, key_length, p->hash, p->key, p->key_length))
+        p = p->next;
+    if (p) {
+        // park behind the leader; if that fails, run the handler uncoalesced
+        if (p->num_waiters == p->waiters_size) {
+            size_t size = p->waiters_size ? p->waiters_size * 2 : 4;
+            void **waiters = (void **)realloc(p->waiters, size * sizeof(void *));
+            if (waiters) {
+                p->waiters = waiters;
+                p->waiters_size = size;
+            }
+        }
+        void *waiter = p->num_waiters < p->waiters_size ? make_waiter(waiter_arg) : NULL;
+        if (waiter) {
+            p->waiters[p->num_waiters++] = waiter;
+            shard->coalesced++;
+            pthread_mutex_unlock(&shard->lock);
+            return RESTINIO_CACHE_WAIT;
+        }
+        shard->misses++;
+        pthread_mutex_unlock(&shard->lock);
+        return RESTINIO_CACHE_MISS;
+    }
+
+    p = (restinio_cache_pending_t *)calloc(1, sizeof(*p) + key_length);
+    if (p) {
+        p->hash = hash;
+        p->key_length = key_length;
+        memcpy(p->key, key, key_length);
+        p->next = shard->pending;
+        shard->pending = p;
+    }
+    shard->misses++;
+    pthread_mutex_unlock(&shard->lock);
+    *pending = p;
+    return RESTINIO_CACHE_MISS;
+}
+
+// caller holds the lock
+static void unlink_pending(cache_shard_t *shard, restinio_cache_pending_t *pending)
+{
+    restinio_cache_pending_t **pp = &shard->pending;
+    while (*pp != pending)
+        pp = &(*pp)->next;
+    *pp = pending->next;
+}
+
+static void serve_waiters(restinio_cache_pending_t *pending,
+                          const restinio_cached_response_t *response,
+                          restinio_cache_waiter_cb serve, void *arg)
+{
+    for (size_t i = 0; i < pending->num_waiters; i++)
+        serve(pending->waiters[i], response, arg);
+    free(pending->waiters);
+    free(pending);
+}
+
+static cache_entry_t *make_entry(const restinio_cache_pending_t *pending,
+                                 int status,
+                                 const char *headers, size_t headers_length, size_t num_headers,
+                                 const struct iovec *body, int body_count)
+{
+    size_t body_length = 0;
+    for (int i = 0; i < body_count; i++)
+        body_length += body[i].iov_len;
+    size_t data_length = pending->key_length + headers_length + body_length;
+    cache_entry_t *entry = (cache_entry_t *)malloc(sizeof(cache_entry_t) + data_length);
+    if (!entry)
+        return NULL;
+    memset(entry, 0, sizeof(*entry));
+    atomic_init(&entry->refs, 1);
+    entry->hash = pending->hash;
+    entry->size = sizeof(cache_entry_t) + data_length;
+    entry->key_length = pending->key_length;
+
+    char *p = entry->data;
+    memcpy(p, pending->key, pending->key_length);
+    entry->key = p;
+    p += pending->key_length;
+
+    if (headers_length)
+        memcpy(p, headers, headers_length);
+    entry->response.headers = p;
+    entry->response.num_headers = num_headers;
+    const char *h = p;
+    for (size_t i = 0; i < num_headers; i++) {
+        const char *value = h + strlen(h) + 1;
+        if (!strcasecmp(h, "ETag"))
+            entry->response.etag = value;
+        h = value + strlen(value) + 1;
+    }
+    p += headers_length;
+
+    entry->response.body = p;
+    entry->response.body_length = body_length;
+    for (int i = 0; i < body_count; i++) {
+        if (body[i].iov_len)
+            memcpy(p, body[i].iov_base, body[i].iov_len);
+        p += body[i].iov_len;
+    }
+    entry->response.status = status;
+    return entry;
+}
+
+const restinio_cached_response_t *restinio_response_cache_fill(
+    restinio_response_cache_t *cache,
+    restinio_cache_pending_t *pending,
+    int status,
+    const char *headers, size_t headers_length, size_t num_headers,
+    const struct iovec *body, int body_count,
+    bool store,
+    restinio_cache_waiter_cb serve, void *arg)
+{
+    cache_entry_t *entry = make_entry(pending, status, headers, headers_length, num_headers,
+                                      body, body_count);
+    cache_shard_t *shard = shard_of(cache, pending->hash);
+
+    pthread_mutex_lock(&shard->lock);
+    unlink_pending(shard, pending);
+    bool stored = false;
+    if (entry && store && entry->size <= cache->max_bytes) {
+        entry->last_used_ms = now_ms();
+        if (cache->ttl_ms)
+            entry->expires_ms = entry->last_used_ms + cache->ttl_ms;
+        cache_entry_t *existing = shard_find(shard, entry->key, entry->key_length, entry->hash);
+        if (existing)
+            shard_remove(cache, shard, existing);
+        stored = shard_insert(cache, shard, entry);
+        if (stored)
+            shard->stores++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    if (stored)
+        cache_trim(cache);
+
+    serve_waiters(pending, entry ? &entry->response : NULL, serve, arg);
+    return entry ? &entry->response : NULL;
+}
+
+void restinio_response_cache_abandon(
+    restinio_response_cache_t *cache,
+    restinio_cache_pending_t *pending,
+    restinio_cache_waiter_cb serve, void *arg)
+{
+    cache_shard_t *shard = shard_of(cache, pending->hash);
+    pthread_mutex_lock(&shard->lock);
+    unlink_pending(shard, pending);
+    pthread_mutex_unlock(&shard->lock);
+    serve_waiters(pending, NULL, serve, arg);
+}
+
+void restinio_response_cache_stats(restinio_response_cache_t *cache,
+                                   restinio_cache_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (size_t i = 0; i < SHARDS; i++) {
+        cache_shard_t *shard = cache->shards + i;
+        pthread_mutex_lock(&shard->lock);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->coalesced += shard->coalesced;
+        stats->stores += shard->stores;
+        stats->evictions += shard->evictions;
+        stats->expirations += shard->expirations;
+        stats->entries += shard->num_entries;
+        stats->bytes += shard->bytes;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+void restinio_response_cache_destroy(restinio_response_cache_t *cache)
+{
+    if (!cache)
+        return;
+    for (size_t i = 0; i < SHARDS; i++) {
+        cache_shard_t *shard = cache->shards + i;
+        while (shard->head)
+            shard_remove(cache, shard, shard->head);
+        free(shard->buckets);
+        while (shard->pending) {
+            restinio_cache_pending_t *next = shard->pending->next;
+            free(shard->pending->waiters);
+            free(shard->pending);
+            shard->pending = next;
+        }
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(cache);
+}
@@ -0,0 +1,97 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef _RESTINIO_RESPONSE_CACHE_H
+#define _RESTINIO_RESPONSE_CACHE_H
+
+/*
+ * Internal: per-route response cache.
+ *
+ * Keys hash to one of a fixed number of shards, each with its own mutex,
+ * hash table and LRU list, so lookups from different I/O threads rarely
+ * meet.  The byte budget is shared: when a store takes the cache over it,
+ * the oldest shard tail is evicted, one shard lock at a time.  Entries
+ * are immutable and reference counted: a hit takes a reference and the
+ * body is written straight from the entry.  The first miss on a key
+ * becomes its leader; later misses are parked on the leader's pending
+ * record and handed the leader's response when it is filled in, so the
+ * handler runs once.
+ */
+
+#include "restinio-c/restinio_c.h"
+
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct restinio_response_cache_s restinio_response_cache_t;
+typedef struct restinio_cache_pending_s restinio_cache_pending_t;
+
+typedef struct {
+    int status;
+    size_t num_headers;
+    const char *headers;        // num_headers pairs of NUL-terminated key, value
+    const char *etag;           // the ETag header's value, NULL if none
+    const char *body;
+    size_t body_length;
+} restinio_cached_response_t;
+
+typedef enum {
+    RESTINIO_CACHE_HIT,         // *entry holds a reference
+    RESTINIO_CACHE_MISS,        // the caller leads: fill or abandon *pending
+    RESTINIO_CACHE_WAIT         // the waiter was parked on the leader
+} restinio_cache_result_t;
+
+// Serves a waiter once its leader is done; entry is NULL when abandoned
+typedef void (*restinio_cache_waiter_cb)(void *waiter,
+                                         const restinio_cached_response_t *entry,
+                                         void *arg);
+
+// ttl_ms 0 keeps entries until they are evicted
+restinio_response_cache_t *restinio_response_cache_create(size_t max_bytes, uint32_t ttl_ms);
+
+void restinio_response_cache_destroy(restinio_response_cache_t *cache);
+
+// make_waiter(waiter_arg) is called, under the shard's lock, only when the
+// result is RESTINIO_CACHE_WAIT
+restinio_cache_result_t restinio_response_cache_lookup(
+    restinio_response_cache_t *cache,
+    const char *key, size_t key_length,
+    void *(*make_waiter)(void *waiter_arg), void *waiter_arg,
+    const restinio_cached_response_t **entry,
+    restinio_cache_pending_t **pending);
+
+// Completes a miss with the leader's response.  It is stored when store is
+// true and it is no larger than max_bytes; either way serve(waiter, entry,
+// arg) runs for every parked waiter (outside the lock) and the returned
+// entry holds a reference for the leader.  NULL if the entry could not be
+// allocated, in which case waiters are served with NULL.
+const restinio_cached_response_t *restinio_response_cache_fill(
+    restinio_response_cache_t *cache,
+    restinio_cache_pending_t *pending,
+    int status,
+    const char *headers, size_t headers_length, size_t num_headers,
+    const struct iovec *body, int body_count,
+    bool store,
+    restinio_cache_waiter_cb serve, void *arg);
+
+// Completes a miss without a response; waiters are served with NULL
+void restinio_response_cache_abandon(
+    restinio_response_cache_t *cache,
+    restinio_cache_pending_t *pending,
+    restinio_cache_waiter_cb serve, void *arg);
+
+void restinio_cached_response_retain(const restinio_cached_response_t *entry);
+void restinio_cached_response_release(const restinio_cached_response_t *entry);
+
+void restinio_response_cache_stats(restinio_response_cache_t *cache,
+                                   restinio_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
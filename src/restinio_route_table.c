@@ -0,0 +1,407 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#include "restinio_route_table.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Standard verbs get a fixed slot; anything else registered is appended
+// after them and one final slot catches methods nobody registered.
+static const char *known_methods[] = {
+    "GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH"
+};
+#define NUM_KNOWN_METHODS (sizeof(known_methods) / sizeof(known_methods[0]))
+
+typedef struct {
+    uint32_t label_offset;
+    uint32_t label_length;
+    uint32_t first_child;
+    uint32_t num_children;
+    uint32_t candidates_offset;
+    uint32_t num_candidates;
+} route_node_t;
+
+struct restinio_route_table_s {
+    route_node_t *nodes;
+    uint8_t *keys;          // keys[i] is the first byte of nodes[i]'s label
+    char *labels;
+    uint32_t *candidates;
+
+    const char **extra_methods;
+    size_t num_extra_methods;
+
+    const char **patterns;  // per route, NULL unless the path has {params}
+
+    size_t num_classes;
+    uint32_t *roots;        // one trie root per method class
+};
+
+typedef struct {
+    const char *path;
+    size_t length;
+    uint32_t index;
+} route_entry_t;
+
+typedef struct {
+    route_node_t *nodes;
+    uint8_t *keys;
+    size_t num_nodes, nodes_size;
+
+    char *labels;
+    size_t labels_length, labels_size;
+
+    uint32_t *candidates;
+    size_t num_candidates, candidates_size;
+
+    bool failed;
+} builder_t;
+
+static bool grow(void **p, size_t *size, size_t needed, size_t elem_size) {
+    if (needed <= *size)
+        return true;
+    size_t n = *size ? *size : 16;
+    while (n < needed)
+        n *= 2;
+    void *np = realloc(*p, n * elem_size);
+    if (!np)
+        return false;
+    *p = np;
+    *size = n;
+    return true;
+}
+
+static uint32_t alloc_nodes(builder_t *b, size_t count) {
+    size_t keys_size = b->nodes_size;
+    if (!grow((void **)&b->nodes, &b->nodes_size, b->num_nodes + count, sizeof(route_node_t))) {
+        b->failed = true;
+        return 0;
+    }
+    if (keys_size != b->nodes_size) {
+        uint8_t *keys = (uint8_t *)realloc(b->keys, b->nodes_size);
+        if (!keys) {
+            b->failed = true;
+            return 0;
+        }
+        b->keys = keys;
+    }
+    uint32_t first = (uint32_t)b->num_nodes;
+    memset(b->nodes + first, 0, count * sizeof(route_node_t));
+    memset(b->keys + first, 0, count);
+    b->num_nodes += count;
+    return first;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const route_entry_t *ea = (const route_entry_t *)a;
+    const route_entry_t *eb = (const route_entry_t *)b;
+    int n = memcmp(ea->path, eb->path, ea->length < eb->length ? ea->length : eb->length);
+    if (n)
+        return n;
+    if (ea->length != eb->length)
+        return ea->length < eb->length ? -1 : 1;
+    return ea->index < eb->index ? -1 : ea->index > eb->index ? 1 : 0;
+}
+
+/*
+ * Fill `node`, which stands for the first `depth` bytes shared by entries
+ * [lo, hi).  Entries are sorted by (path, index) so any entry whose path is
+ * exactly this prefix comes first in the range.  `inherited_*` is the merged
+ * candidate list of the ancestors.
+ */
+static void fill_node(builder_t *b, uint32_t node,
+                      const route_entry_t *e, size_t lo, size_t hi, size_t depth,
+                      uint32_t inherited_offset, uint32_t inherited_count) {
+    if (b->failed)
+        return;
+
+    size_t own_end = lo;
+    while (own_end < hi && e[own_end].length == depth)
+        own_end++;
+
+    uint32_t cand_offset = inherited_offset, cand_count = inherited_count;
+    if (own_end > lo) {
+        size_t own = own_end - lo;
+        if (!grow((void **)&b->candidates, &b->candidates_size,
+                  b->num_candidates + inherited_count + own, sizeof(uint32_t))) {
+            b->failed = true;
+            return;
+        }
+        // merge ancestors and this node's own routes into registration order
+        const uint32_t *in = b->candidates + inherited_offset;
+        uint32_t *out = b->candidates + b->num_candidates;
+        size_t i = 0, j = lo, k = 0;
+        while (i < inherited_count || j < own_end) {
+            if (j == own_end || (i < inherited_count && in[i] < e[j].index))
+                out[k++] = in[i++];
+            else
+                out[k++] = e[j++].index;
+        }
+        cand_offset = (uint32_t)b->num_candidates;
+        cand_count = (uint32_t)k;
+        b->num_candidates += k;
+    }
+    b->nodes[node].candidates_offset = cand_offset;
+    b->nodes[node].num_candidates = cand_count;
+
+    // group the remaining entries by their next byte
+    size_t num_groups = 0;
+    for (size_t i = own_end; i < hi; ) {
+        char ch = e[i].path[depth];
+        while (i < hi && e[i].path[depth] == ch)
+            i++;
+        num_groups++;
+    }
+    if (!num_groups)
+        return;
+
+    uint32_t first_child = alloc_nodes(b, num_groups);
+    if (b->failed)
+        return;
+    b->nodes[node].first_child = first_child;
+    b->nodes[node].num_children = (uint32_t)num_groups;
+
+    uint32_t child = first_child;
+    for (size_t i = own_end; i < hi; child++) {
+        size_t start = i;
+        char ch = e[i].path[depth];
+        while (i < hi && e[i].path[depth] == ch)
+            i++;
+
+        // sorted input => the common prefix of the group is that of its ends
+        const route_entry_t *first = e + start, *last = e + i - 1;
+        size_t end = depth;
+        while (end < first->length && end < last->length &&
+               first->path[end] == last->path[end])
+            end++;
+
+        size_t label_length = end - depth;
+        if (!grow((void **)&b->labels, &b->labels_size,
+                  b->labels_length + label_length, 1)) {
+            b->failed = true;
+            return;
+        }
+        memcpy(b->labels + b->labels_length, first->path + depth, label_length);
+        b->nodes[child].label_offset = (uint32_t)b->labels_length;
+        b->nodes[child].label_length = (uint32_t)label_length;
+        b->keys[child] = (uint8_t)ch;
+        b->labels_length += label_length;
+
+        fill_node(b, child, e, start, i, end, cand_offset, cand_count);
+        if (b->failed)
+            return;
+    }
+}
+
+static bool method_matches(const char *route_method, const char *class_method) {
+    return !route_method[0] || (class_method && !strcmp(route_method, class_method));
+}
+
+static int known_method_id(const char *method, size_t len) {
+    switch (len) {
+    case 3:
+        if (!memcmp(method, "GET", 3)) return 0;
+        if (!memcmp(method, "PUT", 3)) return 3;
+        break;
+    case 4:
+        if (!memcmp(method, "HEAD", 4)) return 1;
+        if (!memcmp(method, "POST", 4)) return 2;
+        break;
+    case 5:
+        if (!memcmp(method, "TRACE", 5)) return 7;
+        if (!memcmp(method, "PATCH", 5)) return 8;
+        break;
+    case 6:
+        if (!memcmp(method, "DELETE", 6)) return 4;
+        break;
+    case 7:
+        if (!memcmp(method, "CONNECT", 7)) return 5;
+        if (!memcmp(method, "OPTIONS", 7)) return 6;
+        break;
+    }
+    return -1;
+}
+
+static size_t method_class(const restinio_route_table_t *table,
+                           const char *method, size_t len) {
+    int id = known_method_id(method, len);
+    if (id >= 0)
+        return (size_t)id;
+    for (size_t i = 0; i < table->num_extra_methods; i++) {
+        const char *m = table->extra_methods[i];
+        if (strlen(m) == len && !memcmp(m, method, len))
+            return NUM_KNOWN_METHODS + i;
+    }
+    return table->num_classes - 1;
+}
+
+restinio_route_table_t *restinio_route_table_build(
+    const restinio_route_spec_t *routes,
+    size_t num_routes) {
+    restinio_route_table_t *table = (restinio_route_table_t *)calloc(1, sizeof(*table));
+    if (!table)
+        return NULL;
+    route_entry_t *entries = (route_entry_t *)malloc((num_routes ? num_routes : 1) * sizeof(route_entry_t));
+    table->extra_methods = (const char **)malloc((num_routes ? num_routes : 1) * sizeof(char *));
+    table->patterns = (const char **)calloc(num_routes ? num_routes : 1, sizeof(char *));
+    if (!entries || !table->extra_methods || !table->patterns)
+        goto fail;
+
+    for (size_t i = 0; i < num_routes; i++) {
+        if (strchr(routes[i].path, '{'))
+            table->patterns[i] = routes[i].path;
+    }
+
+    for (size_t i = 0; i < num_routes; i++) {
+        const char *m = routes[i].method;
+        if (!m[0] || known_method_id(m, strlen(m)) >= 0)
+            continue;
+        size_t j = 0;
+        while (j < table->num_extra_methods && strcmp(table->extra_methods[j], m))
+            j++;
+        if (j == table->num_extra_methods)
+            table->extra_methods[table->num_extra_methods++] = m;
+    }
+    table->num_classes = NUM_KNOWN_METHODS + table->num_extra_methods + 1;
+    table->roots = (uint32_t *)calloc(table->num_classes, sizeof(uint32_t));
+    if (!table->roots)
+        goto fail;
+
+    builder_t b;
+    memset(&b, 0, sizeof(b));
+    for (size_t c = 0; c < table->num_classes && !b.failed; c++) {
+        const char *class_method =
+            c < NUM_KNOWN_METHODS ? known_methods[c]
+          : c < NUM_KNOWN_METHODS + table->num_extra_methods ? table->extra_methods[c - NUM_KNOWN_METHODS]
+          : NULL;
+
+        size_t n = 0;
+        for (size_t i = 0; i < num_routes; i++) {
+            if (!method_matches(routes[i].method, class_method))
+                continue;
+            // pattern routes are indexed by their literal prefix
+            entries[n].path = routes[i].path;
+            entries[n].length = table->patterns[i]
+                ? (size_t)(strchr(routes[i].path, '{') - routes[i].path)
+                : strlen(routes[i].path);
+            entries[n].index = (uint32_t)i;
+            n++;
+        }
+        qsort(entries, n, sizeof(route_entry_t), compare_entries);
+
+        uint32_t root = alloc_nodes(&b, 1);
+        table->roots[c] = root;
+        fill_node(&b, root, entries, 0, n, 0, 0, 0);
+    }
+    if (b.failed) {
+        free(b.nodes);
+        free(b.keys);
+        free(b.labels);
+        free(b.candidates);
+        goto fail;
+    }
+
+    table->nodes = b.nodes;
+    table->keys = b.keys;
+    table->labels = b.labels;
+    table->candidates = b.candidates;
+    free(entries);
+    return table;
+
+fail:
+    free(entries);
+    restinio_route_table_destroy(table);
+    return NULL;
+}
+
+void restinio_route_table_destroy(restinio_route_table_t *table) {
+    if (!table)
+        return;
+    free(table->nodes);
+    free(table->keys);
+    free(table->labels);
+    free(table->candidates);
+    free(table->extra_methods);
+    free(table->patterns);
+    free(table->roots);
+    free(table);
+}
+
+size_t restinio_route_table_match(
+    const restinio_route_table_t *table,
+    const char *method, size_t method_length,
+    const char *target, size_t target_length,
+    const uint32_t **candidates) {
+    const route_node_t *nodes = table->nodes;
+    const route_node_t *node =
+        nodes + table->roots[method_class(table, method, method_length)];
+
+    size_t pos = 0;
+    while (pos < target_length && node->num_children) {
+        const uint8_t *keys = table->keys + node->first_child;
+        uint8_t ch = (uint8_t)target[pos];
+        uint32_t i = 0;
+        while (i < node->num_children && keys[i] < ch)
+            i++;
+        if (i == node->num_children || keys[i] != ch)
+            break;
+
+        const route_node_t *child = nodes + node->first_child + i;
+        if (child->label_length > target_length - pos ||
+            memcmp(table->labels + child->label_offset, target + pos, child->label_length))
+            break;
+        pos += child->label_length;
+        node = child;
+    }
+
+    *candidates = table->candidates ? table->candidates + node->candidates_offset : NULL;
+    return node->num_candidates;
+}
+
+bool restinio_route_table_capture(
+    const restinio_route_table_t *table,
+    uint32_t route,
+    const char *target, size_t target_length,
+    restinio_route_param_t *params,
+    size_t *num_params) {
+    *num_params = 0;
+    const char *p = table->patterns[route];
+    if (!p)
+        return true;
+
+    // parameters only ever match within the path, never the query
+    size_t end = 0;
+    while (end < target_length && target[end] != '?' && target[end] != '#')
+        end++;
+
+    size_t pos = 0;
+    while (*p) {
+        const char *close = *p == '{' ? strchr(p, '}') : NULL;
+        if (!close) {
+            if (pos == end || target[pos] != *p)
+                return false;
+            pos++;
+            p++;
+            continue;
+        }
+
+        size_t start = pos;
+        while (pos < end && target[pos] != '/')
+            pos++;
+        if (pos == start)
+            return false;
+        if (*num_params < RESTINIO_ROUTE_MAX_PARAMS) {
+            restinio_route_param_t *param = params + (*num_params)++;
+            param->name = p + 1;
+            param->name_length = (size_t)(close - p - 1);
+            param->value = target + start;
+            param->value_length = pos - start;
+        }
+        p = close + 1;
+    }
+
+    // like plain routes, a pattern matches a prefix, but only on a segment boundary
+    return pos == end || target[pos] == '/' || p[-1] == '/';
+}
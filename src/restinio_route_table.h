@@ -0,0 +1,76 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef _RESTINIO_ROUTE_TABLE_H
+#define _RESTINIO_ROUTE_TABLE_H
+
+/*
+ * Internal: immutable route index built by restinio_run().
+ *
+ * Routes are bucketed by method (a fixed enum for the standard verbs plus any
+ * extra verbs that were registered) and each bucket holds a compressed byte
+ * trie over the registered path prefixes.  Every trie node carries the list of
+ * routes whose path is a prefix of that node, already merged into
+ * registration order, so a lookup is a single walk down the trie with no
+ * allocation and no string compares beyond the edge labels.
+ *
+ * A path may contain {name} segments.  Only the literal text before the first
+ * one goes into the trie; restinio_route_table_capture() then checks the rest
+ * of the pattern and captures the segment values.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RESTINIO_ROUTE_MAX_PARAMS 16
+
+typedef struct {
+    const char *method; // "" matches every method
+    const char *path;   // "" matches every target, otherwise a prefix of it
+} restinio_route_spec_t;
+
+typedef struct {
+    const char *name;   // points into the registered path
+    size_t name_length;
+    const char *value;  // points into the request target
+    size_t value_length;
+} restinio_route_param_t;
+
+typedef struct restinio_route_table_s restinio_route_table_t;
+
+restinio_route_table_t *restinio_route_table_build(
+    const restinio_route_spec_t *routes,
+    size_t num_routes);
+
+void restinio_route_table_destroy(restinio_route_table_t *table);
+
+// Returns the number of candidate routes for method/target and points
+// *candidates at their indices (into the array given to build) in
+// registration order.  The returned array is owned by the table.
+size_t restinio_route_table_match(
+    const restinio_route_table_t *table,
+    const char *method, size_t method_length,
+    const char *target, size_t target_length,
+    const uint32_t **candidates);
+
+// Checks candidate `route` against the full target and captures its {name}
+// segments into params (at most RESTINIO_ROUTE_MAX_PARAMS).  Routes without
+// parameters always match here with *num_params set to 0.
+bool restinio_route_table_capture(
+    const restinio_route_table_t *table,
+    uint32_t route,
+    const char *target, size_t target_length,
+    restinio_route_param_t *params,
+    size_t *num_params);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
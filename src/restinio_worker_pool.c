@@ -0,0 +1,244 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#include "restinio_worker_pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct {
+    restinio_work_cb cb;
+    void *arg;
+    uint64_t submitted_ns;
+} work_t;
+
+// Ring of queue_depth items guarded by its own lock
+typedef struct {
+    pthread_mutex_t lock;
+    work_t *items;
+    size_t head, count;
+} work_queue_t;
+
+typedef struct {
+    restinio_worker_pool_t *pool;
+    size_t index;
+} worker_t;
+
+struct restinio_worker_pool_s {
+    work_queue_t *queues;
+    worker_t *workers;
+    pthread_t *threads;
+    size_t num_threads;
+    size_t queue_depth;
+
+    atomic_size_t next;     // round-robin submit cursor
+    atomic_size_t queued;   // changed under the queue lock, so never negative
+    atomic_size_t running;
+    atomic_uint_fast64_t completed;
+    atomic_uint_fast64_t rejected;
+    atomic_uint_fast64_t wait_us_total;
+    atomic_uint_fast64_t wait_us_max;
+
+    // Idle workers sleep here.  A worker counts itself in sleepers before
+    // it checks queued, and submit bumps queued before it checks sleepers,
+    // so submit only takes the lock (to signal) when a worker may be asleep
+    // and that worker cannot miss the wakeup.
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle;
+    atomic_size_t sleepers;
+    bool stopping;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static bool queue_pop(restinio_worker_pool_t *pool, work_queue_t *q, work_t *work) {
+    bool found = false;
+    pthread_mutex_lock(&q->lock);
+    if (q->count) {
+        *work = q->items[q->head];
+        q->head = (q->head + 1) % pool->queue_depth;
+        q->count--;
+        atomic_fetch_sub(&pool->queued, 1);
+        found = true;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+// Own queue first, then steal from the others in order
+static bool take(restinio_worker_pool_t *pool, size_t index, work_t *work) {
+    for (size_t i = 0; i < pool->num_threads; i++) {
+        if (queue_pop(pool, &pool->queues[(index + i) % pool->num_threads], work))
+            return true;
+    }
+    return false;
+}
+
+static void run(restinio_worker_pool_t *pool, const work_t *work) {
+    uint64_t waited = (now_ns() - work->submitted_ns) / 1000;
+    atomic_fetch_add(&pool->wait_us_total, waited);
+    uint_fast64_t max = atomic_load(&pool->wait_us_max);
+    while (waited > max && !atomic_compare_exchange_weak(&pool->wait_us_max, &max, waited))
+        ;
+
+    atomic_fetch_add(&pool->running, 1);
+    work->cb(work->arg);
+    atomic_fetch_sub(&pool->running, 1);
+    atomic_fetch_add(&pool->completed, 1);
+}
+
+static void *worker_main(void *arg) {
+    worker_t *worker = (worker_t *)arg;
+    restinio_worker_pool_t *pool = worker->pool;
+    for (;;) {
+        work_t work;
+        if (take(pool, worker->index, &work)) {
+            run(pool, &work);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->idle_lock);
+        atomic_fetch_add(&pool->sleepers, 1);
+        while (!pool->stopping && atomic_load(&pool->queued) == 0)
+            pthread_cond_wait(&pool->idle, &pool->idle_lock);
+        atomic_fetch_sub(&pool->sleepers, 1);
+        bool done = pool->stopping && atomic_load(&pool->queued) == 0;
+        pthread_mutex_unlock(&pool->idle_lock);
+        if (done)
+            return NULL;
+    }
+}
+
+// Wakes every worker to exit and joins the first `started` of them
+static void join_workers(restinio_worker_pool_t *pool, size_t started) {
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->idle);
+    pthread_mutex_unlock(&pool->idle_lock);
+    for (size_t i = 0; i < started; i++)
+        pthread_join(pool->threads[i], NULL);
+}
+
+// Frees every queue, whether or not its worker was started
+static void free_pool(restinio_worker_pool_t *pool) {
+    for (size_t i = 0; i < pool->num_threads; i++) {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+        free(pool->queues[i].items);
+    }
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->queues);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
+
+restinio_worker_pool_t *restinio_worker_pool_create(size_t num_threads, size_t queue_depth) {
+    if (!num_threads || !queue_depth)
+        return NULL;
+
+    restinio_worker_pool_t *pool = (restinio_worker_pool_t *)calloc(1, sizeof(*pool));
+    if (!pool)
+        return NULL;
+    pool->num_threads = num_threads;
+    pool->queue_depth = queue_depth;
+    pool->queues = (work_queue_t *)calloc(num_threads, sizeof(work_queue_t));
+    pool->workers = (worker_t *)calloc(num_threads, sizeof(worker_t));
+    pool->threads = (pthread_t *)calloc(num_threads, sizeof(pthread_t));
+    if (!pool->queues || !pool->workers || !pool->threads)
+        goto fail;
+    for (size_t i = 0; i < num_threads; i++) {
+        pool->queues[i].items = (work_t *)malloc(queue_depth * sizeof(work_t));
+        if (!pool->queues[i].items)
+            goto fail;
+    }
+    // only once nothing else can fail, so the fail path has no locks to undo
+    for (size_t i = 0; i < num_threads; i++)
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (size_t i = 0; i < num_threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->workers[i]) != 0) {
+            join_workers(pool, i);
+            free_pool(pool);
+            return NULL;
+        }
+    }
+    return pool;
+
+fail:
+    if (pool->queues) {
+        for (size_t i = 0; i < num_threads; i++)
+            free(pool->queues[i].items);
+    }
+    free(pool->queues);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+    return NULL;
+}
+
+void restinio_worker_pool_destroy(restinio_worker_pool_t *pool) {
+    if (!pool)
+        return;
+    join_workers(pool, pool->num_threads);
+    free_pool(pool);
+}
+
+bool restinio_worker_pool_submit(restinio_worker_pool_t *pool, restinio_work_cb cb, void *arg) {
+    work_t work = { cb, arg, now_ns() };
+    size_t start = atomic_fetch_add(&pool->next, 1);
+    for (size_t i = 0; i < pool->num_threads; i++) {
+        work_queue_t *q = &pool->queues[(start + i) % pool->num_threads];
+        pthread_mutex_lock(&q->lock);
+        if (q->count < pool->queue_depth) {
+            q->items[(q->head + q->count) % pool->queue_depth] = work;
+            q->count++;
+            atomic_fetch_add(&pool->queued, 1);
+            pthread_mutex_unlock(&q->lock);
+
+            if (atomic_load(&pool->sleepers)) {
+                pthread_mutex_lock(&pool->idle_lock);
+                pthread_cond_signal(&pool->idle);
+                pthread_mutex_unlock(&pool->idle_lock);
+            }
+            return true;
+        }
+        pthread_mutex_unlock(&q->lock);
+    }
+    atomic_fetch_add(&pool->rejected, 1);
+    return false;
+}
+
+size_t restinio_worker_pool_cancel(restinio_worker_pool_t *pool, restinio_work_cb cancel) {
+    size_t cancelled = 0;
+    for (size_t i = 0; i < pool->num_threads; i++) {
+        work_t work;
+        while (queue_pop(pool, &pool->queues[i], &work)) {
+            cancel(work.arg);
+            cancelled++;
+        }
+    }
+    return cancelled;
+}
+
+void restinio_worker_pool_stats(restinio_worker_pool_t *pool,
+                                restinio_worker_pool_stats_t *stats) {
+    stats->threads = pool->num_threads;
+    stats->queued = atomic_load(&pool->queued);
+    stats->running = atomic_load(&pool->running);
+    stats->completed = atomic_load(&pool->completed);
+    stats->rejected = atomic_load(&pool->rejected);
+    stats->wait_us_total = atomic_load(&pool->wait_us_total);
+    stats->wait_us_max = atomic_load(&pool->wait_us_max);
+}
@@ -0,0 +1,58 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef _RESTINIO_WORKER_POOL_H
+#define _RESTINIO_WORKER_POOL_H
+
+/*
+ * Internal: executor for handlers that block.
+ *
+ * Every worker owns a bounded FIFO queue.  Work is submitted round-robin and
+ * spills over to the next queue when one is full; an idle worker steals from
+ * the others before it sleeps.  When every queue is full, submit fails and
+ * the caller sheds the request instead of letting latency grow without bound.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*restinio_work_cb)(void *arg);
+
+typedef struct restinio_worker_pool_s restinio_worker_pool_t;
+
+typedef struct {
+    size_t threads;
+    size_t queued;          // waiting in the queues
+    size_t running;
+    uint64_t completed;
+    uint64_t rejected;      // submits that found every queue full
+    uint64_t wait_us_total; // summed time from submit to start
+    uint64_t wait_us_max;
+} restinio_worker_pool_stats_t;
+
+// queue_depth is per worker
+restinio_worker_pool_t *restinio_worker_pool_create(size_t num_threads, size_t queue_depth);
+
+// Runs whatever is still queued, then joins the workers
+void restinio_worker_pool_destroy(restinio_worker_pool_t *pool);
+
+bool restinio_worker_pool_submit(restinio_worker_pool_t *pool, restinio_work_cb cb, void *arg);
+
+// Takes everything still queued off the queues without running it and
+// calls cancel(arg) for each item instead.  Returns how many were cancelled.
+size_t restinio_worker_pool_cancel(restinio_worker_pool_t *pool, restinio_work_cb cancel);
+
+void restinio_worker_pool_stats(restinio_worker_pool_t *pool,
+                                restinio_worker_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,76 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Cost of access logging: no logging, the asynchronous access log, and a
+// handler that fprintf()s each request itself on the I/O thread.
+
+#include "restinio-c/restinio_c.h"
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static FILE *printf_log;
+
+static restinio_response_t *pong_handler(void *arg, restinio_request_t *req) {
+    (void)req;
+    if (arg)
+        fprintf(printf_log, "GET /ping 200 4\n");
+    restinio_response_builder_t *rb = restinio_response_builder(200);
+    restinio_response_builder_body(rb, "pong", 4);
+    return restinio_response_builder_finish(rb);
+}
+
+static void run_case(const char *name, unsigned short port,
+                     const char *access_log_path, bool use_printf) {
+    restinio_options_t options = {
+        .enable_keepalive = true,
+        .enable_thread_pool = true,
+        .thread_pool_size = 4,
+        .port = port,
+        .address = "127.0.0.1",
+        .access_log_path = access_log_path,
+        .access_log_format = RESTINIO_ACCESS_LOG_JSON
+    };
+    restinio_server_t *server = restinio_server_create(&options);
+    restinio_server_use_view(server, "GET", "/ping", pong_handler, use_printf ? server : NULL);
+    if (!restinio_server_run(server) || !bench_wait_for_port("127.0.0.1", port, 5.0)) {
+        fprintf(stderr, "server did not start on port %u\n", port);
+        exit(1);
+    }
+
+    bench_client_options_t client = {
+        .port = port,
+        .connections = 32,
+        .seconds = 3.0,
+        .target = "/ping"
+    };
+    bench_result_t result;
+    bench_client_run(&client, &result);
+    bench_print_result(name, &result);
+
+    restinio_server_metrics_t m;
+    restinio_server_metrics(server, &m);
+    if (access_log_path)
+        printf("%-28s %10llu dropped\n", "", (unsigned long long)m.access_log_dropped);
+    restinio_server_destroy(server);
+}
+
+int main(int argc, char **argv) {
+    unsigned short port = argc > 1 ? (unsigned short)atoi(argv[1]) : 18087;
+    const char *path = argc > 2 ? argv[2] : "/tmp/restinio_bench_access.log";
+
+    run_case("no logging", port, NULL, false);
+    run_case("access log", (unsigned short)(port + 1), path, false);
+
+    printf_log = fopen(path, "a");
+    if (!printf_log) {
+        perror(path);
+        return 1;
+    }
+    run_case("fprintf in handler", (unsigned short)(port + 2), NULL, true);
+    fclose(printf_log);
+    remove(path);
+    return 0;
+}
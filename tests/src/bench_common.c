@@ -0,0 +1,319 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#define _GNU_SOURCE // memmem
+
+#include "bench_common.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    int fd;
+    char *buf;
+    size_t len, cap;
+} bench_conn_t;
+
+typedef struct {
+    const bench_client_options_t *options;
+    const char *request;
+    size_t request_length;
+    double deadline;
+
+    uint64_t requests, errors, bytes;
+    float *samples;            // latency in microseconds
+    size_t num_samples, samples_size;
+} bench_thread_t;
+
+double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int bench_connect(const char *host, unsigned short port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+bool bench_wait_for_port(const char *host, unsigned short port, double timeout_seconds) {
+    double deadline = bench_now() + timeout_seconds;
+    while (bench_now() < deadline) {
+        int fd = bench_connect(host ? host : "127.0.0.1", port);
+        if (fd >= 0) {
+            close(fd);
+            return true;
+        }
+        usleep(10000);
+    }
+    return false;
+}
+
+static bool send_all(int fd, const char *p, size_t n) {
+    while (n) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+static bool conn_fill(bench_conn_t *c) {
+    if (c->len == c->cap) {
+        size_t cap = c->cap ? c->cap * 2 : 65536;
+        char *buf = (char *)realloc(c->buf, cap);
+        if (!buf)
+            return false;
+        c->buf = buf;
+        c->cap = cap;
+    }
+    ssize_t n = recv(c->fd, c->buf + c->len, c->cap - c->len, 0);
+    if (n <= 0)
+        return false;
+    c->len += (size_t)n;
+    return true;
+}
+
+static const char *find_crlf(const char *p, const char *end) {
+    for (; p + 1 < end; p++) {
+        if (p[0] == '\r' && p[1] == '\n')
+            return p;
+    }
+    return NULL;
+}
+
+static const char *header_value(const char *headers, const char *end, const char *name) {
+    size_t name_length = strlen(name);
+    for (const char *line = headers; line < end; ) {
+        const char *eol = find_crlf(line, end);
+        if (!eol)
+            return NULL;
+        if ((size_t)(eol - line) > name_length && line[name_length] == ':' &&
+            !strncasecmp(line, name, name_length)) {
+            const char *v = line + name_length + 1;
+            while (*v == ' ')
+                v++;
+            return v;
+        }
+        line = eol + 2;
+    }
+    return NULL;
+}
+
+// Reads one response, returns its status or -1.  *bytes gets its size.
+static int read_response(bench_conn_t *c, bool head, size_t *bytes) {
+    size_t header_end;
+    for (;;) {
+        const char *p = c->len >= 4 ? (const char *)memmem(c->buf, c->len, "\r\n\r\n", 4) : NULL;
+        if (p) {
+            header_end = (size_t)(p - c->buf) + 4;
+            break;
+        }
+        if (!conn_fill(c))
+            return -1;
+    }
+
+    int status = c->len > 12 ? atoi(c->buf + 9) : -1;
+    const char *headers_end = c->buf + header_end;
+    const char *cl = header_value(c->buf, headers_end, "Content-Length");
+    const char *te = header_value(c->buf, headers_end, "Transfer-Encoding");
+
+    size_t end = header_end;
+    if (head || status == 204 || status == 304) {
+        // no body
+    } else if (te && !strncasecmp(te, "chunked", 7)) {
+        size_t pos = header_end;
+        for (;;) {
+            const char *eol;
+            while (!(eol = find_crlf(c->buf + pos, c->buf + c->len))) {
+                if (!conn_fill(c))
+                    return -1;
+            }
+            size_t chunk = strtoul(c->buf + pos, NULL, 16);
+            pos = (size_t)(eol - c->buf) + 2 + chunk + 2;
+            while (c->len < pos) {
+                if (!conn_fill(c))
+                    return -1;
+            }
+            if (!chunk)
+                break;
+        }
+        end = pos;
+    } else if (cl) {
+        end = header_end + strtoul(cl, NULL, 10);
+        while (c->len < end) {
+            if (!conn_fill(c))
+                return -1;
+        }
+    }
+
+    *bytes = end;
+    memmove(c->buf, c->buf + end, c->len - end);
+    c->len -= end;
+    return status;
+}
+
+static void add_sample(bench_thread_t *t, double us) {
+    if (t->num_samples == t->samples_size) {
+        size_t size = t->samples_size ? t->samples_size * 2 : 65536;
+        if (size > (64u << 20))
+            return;
+        float *samples = (float *)realloc(t->samples, size * sizeof(float));
+        if (!samples)
+            return;
+        t->samples = samples;
+        t->samples_size = size;
+    }
+    t->samples[t->num_samples++] = (float)us;
+}
+
+static void *bench_thread(void *arg) {
+    bench_thread_t *t = (bench_thread_t *)arg;
+    const bench_client_options_t *o = t->options;
+    const char *host = o->host ? o->host : "127.0.0.1";
+    bool head = o->method && !strcasecmp(o->method, "HEAD");
+    int pipeline = o->pipeline > 0 ? o->pipeline : 1;
+
+    bench_conn_t c;
+    memset(&c, 0, sizeof(c));
+    c.fd = -1;
+
+    while (bench_now() < t->deadline) {
+        if (c.fd < 0) {
+            c.fd = bench_connect(host, o->port);
+            c.len = 0;
+            if (c.fd < 0) {
+                t->errors++;
+                continue;
+            }
+        }
+
+        double start = bench_now();
+        bool ok = true;
+        for (int i = 0; i < pipeline && ok; i++)
+            ok = send_all(c.fd, t->request, t->request_length);
+        for (int i = 0; i < pipeline && ok; i++) {
+            size_t bytes = 0;
+            int status = read_response(&c, head, &bytes);
+            if (status < 0) {
+                ok = false;
+                break;
+            }
+            add_sample(t, (bench_now() - start) * 1e6);
+            t->requests++;
+            t->bytes += bytes;
+            if (status >= 400)
+                t->errors++;
+        }
+
+        if (!ok)
+            t->errors++;
+        if (!ok || o->new_connection_per_request) {
+            close(c.fd);
+            c.fd = -1;
+        }
+    }
+    if (c.fd >= 0)
+        close(c.fd);
+    free(c.buf);
+    return NULL;
+}
+
+static int compare_floats(const void *a, const void *b) {
+    float fa = *(const float *)a, fb = *(const float *)b;
+    return fa < fb ? -1 : fa > fb ? 1 : 0;
+}
+
+bool bench_client_run(const bench_client_options_t *options, bench_result_t *result) {
+    int connections = options->connections > 0 ? options->connections : 1;
+    double seconds = options->seconds > 0 ? options->seconds : 2.0;
+    const char *host = options->host ? options->host : "127.0.0.1";
+
+    size_t request_size = 512 + strlen(options->target) + options->body_length +
+                          (options->headers ? strlen(options->headers) : 0);
+    char *request = (char *)malloc(request_size);
+    int n = snprintf(request, request_size,
+                     "%s %s HTTP/1.1\r\nHost: %s\r\n%s%sContent-Length: %zu\r\n\r\n",
+                     options->method ? options->method : "GET", options->target, host,
+                     options->headers ? options->headers : "",
+                     options->new_connection_per_request ? "Connection: close\r\n" : "",
+                     options->body_length);
+    if (options->body_length)
+        memcpy(request + n, options->body, options->body_length);
+    size_t request_length = (size_t)n + options->body_length;
+
+    bench_thread_t *threads = (bench_thread_t *)calloc((size_t)connections, sizeof(bench_thread_t));
+    pthread_t *ids = (pthread_t *)calloc((size_t)connections, sizeof(pthread_t));
+    double start = bench_now();
+    for (int i = 0; i < connections; i++) {
+        threads[i].options = options;
+        threads[i].request = request;
+        threads[i].request_length = request_length;
+        threads[i].deadline = start + seconds;
+        pthread_create(ids + i, NULL, bench_thread, threads + i);
+    }
+
+    memset(result, 0, sizeof(*result));
+    size_t num_samples = 0;
+    for (int i = 0; i < connections; i++) {
+        pthread_join(ids[i], NULL);
+        result->requests += threads[i].requests;
+        result->errors += threads[i].errors;
+        result->bytes += threads[i].bytes;
+        num_samples += threads[i].num_samples;
+    }
+    result->seconds = bench_now() - start;
+    result->requests_per_second = (double)result->requests / result->seconds;
+
+    float *samples = (float *)malloc((num_samples ? num_samples : 1) * sizeof(float));
+    size_t k = 0;
+    for (int i = 0; i < connections; i++) {
+        memcpy(samples + k, threads[i].samples, threads[i].num_samples * sizeof(float));
+        k += threads[i].num_samples;
+        free(threads[i].samples);
+    }
+    if (num_samples) {
+        qsort(samples, num_samples, sizeof(float), compare_floats);
+        result->p50_us = samples[(size_t)((double)(num_samples - 1) * 0.50)];
+        result->p99_us = samples[(size_t)((double)(num_samples - 1) * 0.99)];
+        result->p999_us = samples[(size_t)((double)(num_samples - 1) * 0.999)];
+    }
+
+    free(samples);
+    free(ids);
+    free(threads);
+    free(request);
+    return result->requests > 0;
+}
+
+void bench_print_result(const char *name, const bench_result_t *result) {
+    printf("%-28s %10.0f req/s  p50 %8.1f us  p99 %8.1f us  p999 %8.1f us  errors %llu\n",
+           name, result->requests_per_second,
+           result->p50_us, result->p99_us, result->p999_us,
+           (unsigned long long)result->errors);
+}
@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef _BENCH_COMMON_H
+#define _BENCH_COMMON_H
+
+// Small blocking HTTP/1.1 load generator shared by the benchmarks.  Each
+// connection runs on its own thread, keeps the connection alive and sends
+// `pipeline` requests back to back before reading the responses.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    const char *host;          // default "127.0.0.1"
+    unsigned short port;
+    const char *method;        // default "GET"
+    const char *target;
+    const char *headers;       // extra raw header lines, each ending in \r\n
+    const char *body;
+    size_t body_length;
+
+    int connections;           // default 1
+    int pipeline;              // requests in flight per connection, default 1
+    double seconds;            // run time, default 2
+    bool new_connection_per_request; // disable keep-alive
+} bench_client_options_t;
+
+typedef struct {
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t bytes;            // response bytes read
+    double seconds;
+    double requests_per_second;
+    double p50_us, p99_us, p999_us;
+} bench_result_t;
+
+double bench_now(void);
+
+bool bench_client_run(const bench_client_options_t *options, bench_result_t *result);
+
+void bench_print_result(const char *name, const bench_result_t *result);
+
+// Waits until something accepts connections on host:port
+bool bench_wait_for_port(const char *host, unsigned short port, double timeout_seconds);
+
+#endif
@@ -0,0 +1,125 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Detached requests completed by a few backend threads: each thread takes
+// whatever has queued up and finishes it one restinio_finish_detached_response
+// at a time, then as a single restinio_finish_detached_many call.
+
+#include "restinio-c/restinio_c.h"
+#include "bench_common.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BACKEND_THREADS 4
+#define MAX_BATCH 256
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t ready;
+    void **handles;
+    size_t count, size;
+    bool batch;
+    bool stopping;
+} backend_t;
+
+static void detached_handler(void *arg, restinio_request_t *req, void *handle) {
+    (void)req;
+    backend_t *backend = (backend_t *)arg;
+    pthread_mutex_lock(&backend->mutex);
+    if (backend->count == backend->size) {
+        backend->size = backend->size ? backend->size * 2 : 1024;
+        backend->handles = (void **)realloc(backend->handles, backend->size * sizeof(void *));
+    }
+    backend->handles[backend->count++] = handle;
+    pthread_cond_signal(&backend->ready);
+    pthread_mutex_unlock(&backend->mutex);
+}
+
+static restinio_response_t *pong(void) {
+    restinio_response_builder_t *rb = restinio_response_builder(200);
+    restinio_response_builder_body(rb, "pong", 4);
+    return restinio_response_builder_finish(rb);
+}
+
+static void *backend_thread(void *arg) {
+    backend_t *backend = (backend_t *)arg;
+    void *handles[MAX_BATCH];
+    restinio_response_t *responses[MAX_BATCH];
+    for (;;) {
+        pthread_mutex_lock(&backend->mutex);
+        while (!backend->count && !backend->stopping)
+            pthread_cond_wait(&backend->ready, &backend->mutex);
+        if (!backend->count) {
+            pthread_mutex_unlock(&backend->mutex);
+            return NULL;
+        }
+        size_t n = backend->count < MAX_BATCH ? backend->count : MAX_BATCH;
+        backend->count -= n;
+        for (size_t i = 0; i < n; i++)
+            handles[i] = backend->handles[backend->count + i];
+        pthread_mutex_unlock(&backend->mutex);
+
+        for (size_t i = 0; i < n; i++)
+            responses[i] = pong();
+        if (backend->batch) {
+            restinio_finish_detached_many(handles, responses, n);
+        } else {
+            for (size_t i = 0; i < n; i++)
+                restinio_finish_detached_response(handles[i], responses[i]);
+        }
+    }
+}
+
+static void run_case(const char *name, unsigned short port, bool batch) {
+    backend_t backend = { .batch = batch };
+    pthread_mutex_init(&backend.mutex, NULL);
+    pthread_cond_init(&backend.ready, NULL);
+    pthread_t threads[BACKEND_THREADS];
+    for (int i = 0; i < BACKEND_THREADS; i++)
+        pthread_create(threads + i, NULL, backend_thread, &backend);
+
+    restinio_options_t options = {
+        .enable_keepalive = true,
+        .enable_thread_pool = true,
+        .thread_pool_size = 4,
+        .port = port,
+        .address = "127.0.0.1"
+    };
+    restinio_server_t *server = restinio_server_create(&options);
+    restinio_server_use_detached_view(server, "GET", "/ping", detached_handler, &backend);
+    if (!restinio_server_run(server) || !bench_wait_for_port("127.0.0.1", port, 5.0)) {
+        fprintf(stderr, "server did not start on port %u\n", port);
+        exit(1);
+    }
+
+    bench_client_options_t client = {
+        .port = port,
+        .connections = 64,
+        .pipeline = 4,
+        .seconds = 3.0,
+        .target = "/ping"
+    };
+    bench_result_t result;
+    bench_client_run(&client, &result);
+    bench_print_result(name, &result);
+
+    pthread_mutex_lock(&backend.mutex);
+    backend.stopping = true;
+    pthread_cond_broadcast(&backend.ready);
+    pthread_mutex_unlock(&backend.mutex);
+    for (int i = 0; i < BACKEND_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    restinio_server_drain(server, 1000);
+    restinio_server_destroy(server);
+    free(backend.handles);
+}
+
+int main(int argc, char **argv) {
+    unsigned short port = argc > 1 ? (unsigned short)atoi(argv[1]) : 18100;
+    run_case("finish one at a time", port, false);
+    run_case("finish_detached_many", (unsigned short)(port + 1), true);
+    return 0;
+}
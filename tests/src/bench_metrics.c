@@ -0,0 +1,65 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Cost of enable_metrics: the same small response with metrics off and on,
+// then the recorded server-side latencies next to the client's view.
+
+#include "restinio-c/restinio_c.h"
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static restinio_response_t *pong_handler(void *arg, restinio_request_t *req) {
+    (void)arg; (void)req;
+    restinio_response_builder_t *rb = restinio_response_builder(200);
+    restinio_response_builder_body(rb, "pong", 4);
+    return restinio_response_builder_finish(rb);
+}
+
+static void run_case(const char *name, unsigned short port, bool metrics) {
+    restinio_options_t options = {
+        .enable_keepalive = true,
+        .enable_thread_pool = true,
+        .thread_pool_size = 4,
+        .port = port,
+        .address = "127.0.0.1",
+        .enable_metrics = metrics
+    };
+    restinio_server_t *server = restinio_server_create(&options);
+    restinio_route_t *route = restinio_server_use_view(server, "GET", "/ping", pong_handler, NULL);
+    if (metrics)
+        restinio_server_use_metrics(server, "/metrics");
+    if (!restinio_server_run(server) || !bench_wait_for_port("127.0.0.1", port, 5.0)) {
+        fprintf(stderr, "server did not start on port %u\n", port);
+        exit(1);
+    }
+
+    bench_client_options_t client = {
+        .port = port,
+        .connections = 32,
+        .seconds = 3.0,
+        .target = "/ping"
+    };
+    bench_result_t result;
+    bench_client_run(&client, &result);
+    bench_print_result(name, &result);
+
+    restinio_route_metrics_t m;
+    if (restinio_route_metrics(route, &m)) {
+        printf("%-28s %10llu recorded  handler p50 %llu us  p99 %llu us  total p99 %llu us\n", "",
+               (unsigned long long)m.requests,
+               (unsigned long long)restinio_histogram_percentile(&m.handler, 50),
+               (unsigned long long)restinio_histogram_percentile(&m.handler, 99),
+               (unsigned long long)restinio_histogram_percentile(&m.total, 99));
+    }
+    restinio_server_destroy(server);
+}
+
+int main(int argc, char **argv) {
+    unsigned short port = argc > 1 ? (unsigned short)atoi(argv[1]) : 18085;
+    run_case("metrics off", port, false);
+    run_case("metrics on", (unsigned short)(port + 1), true);
+    return 0;
+}
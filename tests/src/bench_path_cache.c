@@ -0,0 +1,109 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Serves a generated /docs tree (a small index.html, a Swagger-sized JS
+// bundle and a large artifact) at high concurrency, with the path handler's
+// file cache and sendfile path disabled and enabled, and the bundle once more
+// to a client that accepts gzip.
+
+#include "restinio-c/restinio_c.h"
+#include "restinio-c/handlers/restinio_path.h"
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void write_file(const char *dir, const char *name, size_t size) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    for (size_t i = 0; i < size; i++)
+        fputc('a' + (int)(i % 26), f);
+    fclose(f);
+}
+
+int main(int argc, char **argv) {
+    unsigned short port = argc > 1 ? (unsigned short)atoi(argv[1]) : 18082;
+    char dir[] = "/tmp/restinio_c_docsXXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    write_file(dir, "index.html", 2 * 1024);
+    write_file(dir, "swagger-ui-bundle.js", 400 * 1024);
+    write_file(dir, "artifact.bin", 16 * 1024 * 1024);
+
+    restinio_options_t options = {
+        .enable_keepalive = true,
+        .enable_thread_pool = true,
+        .thread_pool_size = 4,
+        .port = port,
+        .address = "127.0.0.1"
+    };
+    restinio_init(&options);
+
+    restinio_path_handler_t *uncached = restinio_path_handler(dir, "/uncached", true);
+    restinio_path_handler_cache(uncached, 0, 0);
+    restinio_path_handler_t *docs = restinio_path_handler(dir, "/docs", true);
+
+    restinio_use("GET", "/uncached", restinio_path_handler_cb, uncached);
+    restinio_use_view("GET", "/docs", restinio_path_handler_view_cb, docs);
+    restinio_run();
+
+    if (!bench_wait_for_port("127.0.0.1", port, 5.0)) {
+        fprintf(stderr, "server did not start on port %u\n", port);
+        return 1;
+    }
+
+    static const char *files[] = { "/index.html", "/swagger-ui-bundle.js", "/artifact.bin" };
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        char target[128], name[128];
+        bench_client_options_t client = {
+            .port = port,
+            .connections = 64,
+            .seconds = 3.0,
+            .target = target
+        };
+        bench_result_t result;
+
+        snprintf(target, sizeof(target), "/uncached%s", files[i]);
+        snprintf(name, sizeof(name), "read per request %s", files[i]);
+        bench_client_run(&client, &result);
+        bench_print_result(name, &result);
+
+        snprintf(target, sizeof(target), "/docs%s", files[i]);
+        snprintf(name, sizeof(name), "cache/sendfile %s", files[i]);
+        bench_client_run(&client, &result);
+        bench_print_result(name, &result);
+    }
+
+    bench_client_options_t gzip_client = {
+        .port = port,
+        .connections = 64,
+        .seconds = 3.0,
+        .target = "/docs/swagger-ui-bundle.js",
+        .headers = "Accept-Encoding: gzip\r\n"
+    };
+    bench_result_t result;
+    bench_client_run(&gzip_client, &result);
+    bench_print_result("gzip /swagger-ui-bundle.js", &result);
+    printf("%-28s %10.1f MiB/s on the wire\n", "",
+           (double)result.bytes / result.seconds / (1024.0 * 1024.0));
+
+    restinio_destroy();
+
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s%s", dir, files[i]);
+        unlink(path);
+    }
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Small JSON response throughput: hand-built malloc/strdup restinio_response_t
+// versus the pooled response builder.
+
+#include "restinio-c/restinio_c.h"
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char json_body[] =
+    "{\"id\":42,\"name\":\"widget\",\"tags\":[\"a\",\"b\",\"c\"],\"ok\":true}";
+
+static void destroy_response(restinio_response_t *response) {
+    free(response->response);
+    free(response->error_message);
+    restinio_header_t *header = response->headers;
+    while (header) {
+        restinio_header_t *next = header->next;
+        free(header->key);
+        free(header->value);
+        free(header);
+        header = next;
+    }
+    free(response);
+}
+
+static restinio_response_t *legacy_handler(void *arg, const char *method, const char *uri,
+                                           const char *body, size_t body_length) {
+    (void)arg; (void)method; (void)uri; (void)body; (void)body_length;
+    restinio_response_t *response = (restinio_response_t *)calloc(1, sizeof(*response));
+    response->response = strdup(json_body);
+    response->response_length = strlen(json_body);
+    response->headers = (restinio_header_t *)calloc(1, sizeof(restinio_header_t));
+    response->headers->key = strdup("Content-Type");
+    response->headers->value = strdup("application/json");
+    response->destroy = destroy_response;
+    return response;
+}
+
+static restinio_response_t *builder_handler(void *arg, restinio_request_t *req) {
+    (void)arg; (void)req;
+    restinio_response_builder_t *rb = restinio_response_builder(200);
+    restinio_response_builder_header(rb, "Content-Type", "application/json");
+    restinio_response_builder_body(rb, json_body, sizeof(json_body) - 1);
+    return restinio_response_builder_finish(rb);
+}
+
+int main(int argc, char **argv) {
+    unsigned short port = argc > 1 ? (unsigned short)atoi(argv[1]) : 18081;
+    restinio_options_t options = {
+        .enable_keepalive = true,
+        .enable_thread_pool = true,
+        .thread_pool_size = 4,
+        .port = port,
+        .address = "127.0.0.1"
+    };
+
+    restinio_init(&options);
+    restinio_use("GET", "/legacy", legacy_handler, NULL);
+    restinio_use_view("GET", "/builder", builder_handler, NULL);
+    restinio_run();
+
+    if (!bench_wait_for_port("127.0.0.1", port, 5.0)) {
+        fprintf(stderr, "server did not start on port %u\n", port);
+        return 1;
+    }
+
+    bench_client_options_t client = {
+        .port = port,
+        .connections = 32,
+        .seconds = 3.0
+    };
+    bench_result_t result;
+
+    client.target = "/legacy";
+    bench_client_run(&client, &result);
+    bench_print_result("malloc/strdup response", &result);
+
+    client.target = "/builder";
+    bench_client_run(&client, &result);
+    bench_print_result("pooled response builder", &result);
+
+    restinio_destroy();
+    return 0;
+}
@@ -0,0 +1,121 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Compares the frozen route table with the linear g_path_map walk that
+// make_request_handler() used before it, at 10, 100 and 1000 routes.
+
+#include "restinio_route_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct route_s {
+    char method[8];
+    char path[64];
+    struct route_s *next;
+} route_t;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// The pre-table dispatch loop, minus the callbacks
+static const route_t *linear_match(const route_t *head, const char *method, const char *uri) {
+    for (const route_t *r = head; r; r = r->next) {
+        if ((!r->method[0] || !strcmp(method, r->method)) &&
+            (!r->path[0] || !strncmp(uri, r->path, strlen(r->path))))
+            return r;
+    }
+    return NULL;
+}
+
+static void run(size_t num_routes, size_t iterations) {
+    static const char *methods[] = { "GET", "POST", "PUT", "DELETE" };
+    route_t *routes = (route_t *)calloc(num_routes, sizeof(route_t));
+    restinio_route_spec_t *specs = (restinio_route_spec_t *)calloc(num_routes, sizeof(*specs));
+
+    for (size_t i = 0; i < num_routes; i++) {
+        strcpy(routes[i].method, methods[i % 4]);
+        snprintf(routes[i].path, sizeof(routes[i].path), "/api/v1/service%04zu/items", i);
+        routes[i].next = i + 1 < num_routes ? routes + i + 1 : NULL;
+        specs[i].method = routes[i].method;
+        specs[i].path = routes[i].path;
+    }
+
+    // requests hit every route, with a suffix so matching is by prefix
+    size_t num_targets = num_routes;
+    char (*targets)[96] = calloc(num_targets, sizeof(*targets));
+    size_t *target_lengths = (size_t *)calloc(num_targets, sizeof(size_t));
+    for (size_t i = 0; i < num_targets; i++) {
+        snprintf(targets[i], sizeof(targets[i]), "%s/%zu?verbose=1", routes[i].path, i * 7);
+        target_lengths[i] = strlen(targets[i]);
+    }
+
+    restinio_route_table_t *table = restinio_route_table_build(specs, num_routes);
+    if (!table) {
+        fprintf(stderr, "failed to build route table\n");
+        exit(1);
+    }
+
+    // both must pick the same first route for every target before timing
+    // means anything; tests/src/test_route_table.c covers the general case
+    for (size_t t = 0; t < num_targets; t++) {
+        const uint32_t *candidates;
+        const char *method = routes[t].method;
+        const route_t *expected = linear_match(routes, method, targets[t]);
+        size_t n = restinio_route_table_match(table, method, strlen(method),
+                                              targets[t], target_lengths[t], &candidates);
+        if (!expected || !n || routes + candidates[0] != expected) {
+            fprintf(stderr, "mismatch for %s %s: linear route %ld, table route %ld\n",
+                    method, targets[t], expected ? (long)(expected - routes) : -1L,
+                    n ? (long)candidates[0] : -1L);
+            exit(1);
+        }
+    }
+
+    size_t hits = 0;
+    double start = now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        size_t t = i % num_targets;
+        if (linear_match(routes, routes[t].method, targets[t]))
+            hits++;
+    }
+    double linear_ns = (now_ns() - start) / (double)iterations;
+
+    start = now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        size_t t = i % num_targets;
+        const uint32_t *candidates;
+        const char *method = routes[t].method;
+        if (restinio_route_table_match(table, method, strlen(method),
+                                       targets[t], target_lengths[t], &candidates))
+            hits++;
+    }
+    double table_ns = (now_ns() - start) / (double)iterations;
+
+    if (hits != iterations * 2) {
+        fprintf(stderr, "mismatch: %zu hits for %zu lookups\n", hits, iterations * 2);
+        exit(1);
+    }
+
+    printf("%6zu routes  linear %10.1f ns/lookup  table %8.1f ns/lookup  speedup %6.1fx\n",
+           num_routes, linear_ns, table_ns, linear_ns / table_ns);
+
+    restinio_route_table_destroy(table);
+    free(target_lengths);
+    free(targets);
+    free(specs);
+    free(routes);
+}
+
+int main(void) {
+    run(10, 2000000);
+    run(100, 1000000);
+    run(1000, 200000);
+    return 0;
+}
@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Effect of the listener and connection options: a connection storm (one
+// request per connection) against 1 and 16 concurrent accepts, and small
+// pipelined requests against max_pipelined_requests of 1 and 16.
+
+#include "restinio-c/restinio_c.h"
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static restinio_response_t *pong_handler(void *arg, restinio_request_t *req) {
+    (void)arg; (void)req;
+    restinio_response_builder_t *rb = restinio_response_builder(200);
+    restinio_response_builder_body(rb, "pong", 4);
+    return restinio_response_builder_finish(rb);
+}
+
+static void run_case(const char *name, restinio_options_t *options,
+                     bench_client_options_t *client) {
+    restinio_server_t *server = restinio_server_create(options);
+    restinio_server_use_view(server, "GET", "/ping", pong_handler, NULL);
+    if (!restinio_server_run(server) ||
+        !bench_wait_for_port("127.0.0.1", options->port, 5.0)) {
+        fprintf(stderr, "server did not start on port %u\n", options->port);
+        exit(1);
+    }
+
+    bench_result_t result;
+    client->port = options->port;
+    bench_client_run(client, &result);
+    bench_print_result(name, &result);
+
+    restinio_server_destroy(server);
+}
+
+int main(int argc, char **argv) {
+    unsigned short port = argc > 1 ? (unsigned short)atoi(argv[1]) : 18083;
+    restinio_options_t options = {
+        .enable_keepalive = true,
+        .enable_thread_pool = true,
+        .thread_pool_size = 4,
+        .address = "127.0.0.1",
+        .tcp_nodelay = true,
+        .reuse_port = true
+    };
+
+    bench_client_options_t storm = {
+        .connections = 128,
+        .seconds = 3.0,
+        .target = "/ping",
+        .new_connection_per_request = true
+    };
+    options.port = port;
+    options.concurrent_accepts = 1;
+    run_case("storm, 1 accept", &options, &storm);
+    options.port = port + 1;
+    options.concurrent_accepts = 16;
+    options.separate_accept_and_create_connect = true;
+    run_case("storm, 16 accepts", &options, &storm);
+
+    bench_client_options_t pipelined = {
+        .connections = 32,
+        .pipeline = 16,
+        .seconds = 3.0,
+        .target = "/ping"
+    };
+    options.concurrent_accepts = 0;
+    options.separate_accept_and_create_connect = false;
+    options.port = port + 2;
+    options.max_pipelined_requests = 1;
+    run_case("pipeline 16, 1 read ahead", &options, &pipelined);
+    options.port = port + 3;
+    options.max_pipelined_requests = 16;
+    run_case("pipeline 16, 16 read ahead", &options, &pipelined);
+    return 0;
+}
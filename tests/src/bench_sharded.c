@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Pooled (one io_context, N threads) versus sharded (N SO_REUSEPORT
+// listeners, one pinned thread each) at 1 to 32 cores, under keep-alive
+// load and under a connection storm.
+
+#include "restinio-c/restinio_c.h"
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static restinio_response_t *pong_handler(void *arg, restinio_request_t *req) {
+    (void)arg; (void)req;
+    restinio_response_builder_t *rb = restinio_response_builder(200);
+    restinio_response_builder_body(rb, "pong", 4);
+    return restinio_response_builder_finish(rb);
+}
+
+static void run_case(const char *mode, int cores, restinio_options_t *options) {
+    restinio_server_t *server = restinio_server_create(options);
+    restinio_server_use_view(server, "GET", "/ping", pong_handler, NULL);
+    if (!restinio_server_run(server) ||
+        !bench_wait_for_port("127.0.0.1", options->port, 5.0)) {
+        fprintf(stderr, "server did not start on port %u\n", options->port);
+        exit(1);
+    }
+
+    bench_client_options_t client = {
+        .port = options->port,
+        .connections = 256,
+        .seconds = 2.0,
+        .target = "/ping"
+    };
+    bench_result_t result;
+    char name[64];
+
+    snprintf(name, sizeof(name), "%s %2d keep-alive", mode, cores);
+    bench_client_run(&client, &result);
+    bench_print_result(name, &result);
+
+    client.new_connection_per_request = true;
+    snprintf(name, sizeof(name), "%s %2d storm", mode, cores);
+    bench_client_run(&client, &result);
+    bench_print_result(name, &result);
+
+    restinio_server_destroy(server);
+}
+
+int main(int argc, char **argv) {
+    unsigned short port = argc > 1 ? (unsigned short)atoi(argv[1]) : 18084;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int cores = 1; cores <= 32 && cores <= cpus; cores *= 2) {
+        restinio_options_t pooled = {
+            .enable_keepalive = true,
+            .enable_thread_pool = true,
+            .thread_pool_size = cores,
+            .port = port++,
+            .address = "127.0.0.1",
+            .tcp_nodelay = true
+        };
+        run_case("pooled ", cores, &pooled);
+
+        restinio_options_t sharded = {
+            .enable_keepalive = true,
+            .port = port++,
+            .address = "127.0.0.1",
+            .tcp_nodelay = true,
+            .shards = cores
+        };
+        run_case("sharded", cores, &sharded);
+    }
+    return 0;
+}
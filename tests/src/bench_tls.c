@@ -0,0 +1,224 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// TLS handshake rate against a self-signed P-256 certificate generated at
+// startup: every connection does a full handshake, then every connection
+// resumes the session of the previous one (tickets, then the server-side
+// session cache).  Each connection sends one request with Connection: close.
+
+#include "restinio-c/restinio_c.h"
+#include "bench_common.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef struct {
+    SSL_CTX *ctx;
+    unsigned short port;
+    bool resume;
+    double seconds;
+
+    double *samples;
+    size_t num_samples, samples_size;
+    uint64_t errors, resumed;
+} tls_thread_t;
+
+static bool write_certificate(const char *cert_file, const char *key_file) {
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    X509 *cert = X509_new();
+    if (!key || !cert)
+        return false;
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"localhost",
+                               -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+
+    FILE *f = fopen(cert_file, "w");
+    bool ok = f && PEM_write_X509(f, cert);
+    if (f)
+        fclose(f);
+    f = fopen(key_file, "w");
+    ok = ok && f && PEM_write_PrivateKey(f, key, NULL, NULL, 0, NULL, NULL);
+    if (f)
+        fclose(f);
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ok;
+}
+
+static int tcp_connect(unsigned short port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// One connection: handshake, GET /ping, read to EOF
+static bool tls_request(tls_thread_t *t, SSL_SESSION **session) {
+    static const char request[] = "GET /ping HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    int fd = tcp_connect(t->port);
+    if (fd < 0)
+        return false;
+    SSL *ssl = SSL_new(t->ctx);
+    SSL_set_fd(ssl, fd);
+    if (*session)
+        SSL_set_session(ssl, *session);
+
+    bool ok = SSL_connect(ssl) == 1 &&
+              SSL_write(ssl, request, (int)sizeof(request) - 1) == (int)sizeof(request) - 1;
+    char buffer[1024];
+    while (ok && SSL_read(ssl, buffer, sizeof(buffer)) > 0)
+        ;
+    if (ok && SSL_session_reused(ssl))
+        t->resumed++;
+    if (ok && t->resume) {
+        SSL_SESSION_free(*session);
+        *session = SSL_get1_session(ssl);
+    }
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(fd);
+    return ok;
+}
+
+static void *tls_thread(void *arg) {
+    tls_thread_t *t = (tls_thread_t *)arg;
+    SSL_SESSION *session = NULL;
+    double end = bench_now() + t->seconds;
+    while (bench_now() < end) {
+        double start = bench_now();
+        if (!tls_request(t, &session)) {
+            t->errors++;
+            continue;
+        }
+        if (t->num_samples == t->samples_size) {
+            t->samples_size = t->samples_size ? t->samples_size * 2 : 4096;
+            t->samples = (double *)realloc(t->samples, t->samples_size * sizeof(double));
+        }
+        t->samples[t->num_samples++] = (bench_now() - start) * 1e6;
+    }
+    SSL_SESSION_free(session);
+    return NULL;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run_case(const char *name, unsigned short port, bool resume, int threads) {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT);
+    tls_thread_t *t = (tls_thread_t *)calloc((size_t)threads, sizeof(tls_thread_t));
+    pthread_t *ids = (pthread_t *)calloc((size_t)threads, sizeof(pthread_t));
+
+    double start = bench_now();
+    for (int i = 0; i < threads; i++) {
+        t[i] = (tls_thread_t){ .ctx = ctx, .port = port, .resume = resume, .seconds = 3.0 };
+        pthread_create(&ids[i], NULL, tls_thread, &t[i]);
+    }
+    size_t total = 0;
+    uint64_t resumed = 0;
+    bench_result_t result = {0};
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+        total += t[i].num_samples;
+        resumed += t[i].resumed;
+        result.errors += t[i].errors;
+    }
+    result.seconds = bench_now() - start;
+
+    double *all = (double *)malloc((total ? total : 1) * sizeof(double));
+    size_t n = 0;
+    for (int i = 0; i < threads; i++) {
+        memcpy(all + n, t[i].samples, t[i].num_samples * sizeof(double));
+        n += t[i].num_samples;
+        free(t[i].samples);
+    }
+    qsort(all, total, sizeof(double), compare_doubles);
+    result.requests = total;
+    result.requests_per_second = (double)total / result.seconds;
+    if (total) {
+        result.p50_us = all[total / 2];
+        result.p99_us = all[total * 99 / 100];
+        result.p999_us = all[total * 999 / 1000];
+    }
+    bench_print_result(name, &result);
+    printf("%-28s %10.1f%% resumed\n", "", total ? 100.0 * (double)resumed / (double)total : 0.0);
+
+    free(all);
+    free(ids);
+    free(t);
+    SSL_CTX_free(ctx);
+}
+
+static restinio_response_t *pong_handler(void *arg, restinio_request_t *req) {
+    (void)arg; (void)req;
+    restinio_response_builder_t *rb = restinio_response_builder(200);
+    restinio_response_builder_body(rb, "pong", 4);
+    return restinio_response_builder_finish(rb);
+}
+
+int main(int argc, char **argv) {
+    unsigned short port = argc > 1 ? (unsigned short)atoi(argv[1]) : 18443;
+    char dir[] = "/tmp/restinio_c_tlsXXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char cert_file[512], key_file[512];
+    snprintf(cert_file, sizeof(cert_file), "%s/cert.pem", dir);
+    snprintf(key_file, sizeof(key_file), "%s/key.pem", dir);
+    if (!write_certificate(cert_file, key_file)) {
+        fprintf(stderr, "cannot write a self-signed certificate\n");
+        return 1;
+    }
+
+    restinio_options_t options = {
+        .enable_ssl = true,
+        .cert_file = cert_file,
+        .key_file = key_file,
+        .enable_thread_pool = true,
+        .thread_pool_size = 4,
+        .port = port,
+        .address = "127.0.0.1"
+    };
+    restinio_server_t *server = restinio_server_create(&options);
+    restinio_server_use_view(server, "GET", "/ping", pong_handler, NULL);
+    if (!restinio_server_run(server) || !bench_wait_for_port("127.0.0.1", port, 5.0)) {
+        fprintf(stderr, "server did not start on port %u\n", port);
+        return 1;
+    }
+
+    run_case("full handshakes", port, false, 16);
+    run_case("resumed handshakes", port, true, 16);
+    restinio_server_reload_tls(server);
+    run_case("resumed after reload", port, true, 16);
+
+    restinio_server_destroy(server);
+    unlink(cert_file);
+    unlink(key_file);
+    rmdir(dir);
+    return 0;
+}
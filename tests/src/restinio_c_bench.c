@@ -0,0 +1,350 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Regression suite: one in-process server on loopback driven by the shared
+// load generator across sync, constant, detached and static-file routes, with
+// keep-alive, pipelining, a connection per request and several body sizes.
+// Each case reports req/s, p50/p99/p999 latency and heap allocations per
+// request; --json writes the same as one document for tracking across
+// releases of the library and of Restinio.
+//
+//   restinio_c_bench [--seconds S] [--connections N] [--port P]
+//                    [--filter SUBSTRING] [--label TEXT] [--json FILE]
+
+#include <stdlib.h>
+
+#include "restinio-c/restinio_c.h"
+#include "restinio-c/handlers/restinio_path.h"
+#include "bench_common.h"
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Allocations are counted by interposing malloc and friends over glibc's;
+// the counts include the client threads, whose buffers only grow
+// logarithmically and so round away per request.
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+#define COUNT_ALLOCATIONS 1
+
+#define STRIPES 16
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *p);
+
+static struct {
+    _Alignas(64) atomic_uint_fast64_t count;
+} allocations[STRIPES];
+
+static atomic_uint next_stripe;
+static _Thread_local unsigned thread_stripe = UINT_MAX;
+
+static void count_allocation(void) {
+    if (thread_stripe == UINT_MAX)
+        thread_stripe = atomic_fetch_add(&next_stripe, 1) % STRIPES;
+    atomic_fetch_add_explicit(&allocations[thread_stripe].count, 1, memory_order_relaxed);
+}
+
+static uint64_t allocation_count(void) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < STRIPES; i++)
+        total += atomic_load_explicit(&allocations[i].count, memory_order_relaxed);
+    return total;
+}
+
+void *malloc(size_t size) {
+    count_allocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    count_allocation();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *p, size_t size) {
+    count_allocation();
+    return __libc_realloc(p, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    count_allocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    count_allocation();
+    void *p = __libc_memalign(alignment, size);
+    if (!p)
+        return 12; // ENOMEM
+    *out = p;
+    return 0;
+}
+
+void free(void *p) {
+    __libc_free(p);
+}
+#else
+#define COUNT_ALLOCATIONS 0
+
+static uint64_t allocation_count(void) {
+    return 0;
+}
+#endif
+
+typedef struct {
+    const char *name;
+    const char *method;
+    const char *target;
+    size_t body_length;
+    int pipeline;
+    bool new_connection_per_request;
+} bench_case_t;
+
+typedef struct {
+    const bench_case_t *test;
+    int connections;
+    bench_result_t result;
+    double allocations_per_request;
+} bench_run_t;
+
+static const bench_case_t cases[] = {
+    { "sync keepalive", "GET", "/sync", 0, 1, false },
+    { "sync pipelined x16", "GET", "/sync", 0, 16, false },
+    { "sync connection close", "GET", "/sync", 0, 1, true },
+    { "constant route keepalive", "GET", "/health", 0, 1, false },
+    { "sync echo 64B", "POST", "/echo", 64, 1, false },
+    { "sync echo 4KiB", "POST", "/echo", 4096, 1, false },
+    { "sync echo 64KiB", "POST", "/echo", 65536, 1, false },
+    { "detached keepalive", "GET", "/detached", 0, 1, false },
+    { "detached pipelined x16", "GET", "/detached", 0, 16, false },
+    { "static 2KiB cached", "GET", "/static/small.html", 0, 1, false },
+    { "static 1MiB sendfile", "GET", "/static/large.bin", 0, 1, false },
+};
+
+static restinio_response_t *sync_handler(void *arg, restinio_request_t *req) {
+    (void)arg; (void)req;
+    restinio_response_builder_t *rb = restinio_response_builder(200);
+    restinio_response_builder_header(rb, "Content-Type", "text/plain");
+    restinio_response_builder_body(rb, "pong", 4);
+    return restinio_response_builder_finish(rb);
+}
+
+static restinio_response_t *echo_handler(void *arg, restinio_request_t *req) {
+    (void)arg;
+    size_t length;
+    const char *body = restinio_request_body(req, &length);
+    restinio_response_builder_t *rb = restinio_response_builder(200);
+    restinio_response_builder_header(rb, "Content-Type", "application/octet-stream");
+    restinio_response_builder_body(rb, body, length);
+    return restinio_response_builder_finish(rb);
+}
+
+static void detached_handler(void *arg, restinio_request_t *req, void *handle) {
+    (void)arg;
+    restinio_finish_detached_response(handle, sync_handler(NULL, req));
+}
+
+static void write_file(const char *dir, const char *name, size_t size) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    for (size_t i = 0; i < size; i++)
+        fputc('a' + (int)(i % 26), f);
+    fclose(f);
+}
+
+static void remove_file(const char *dir, const char *name) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    unlink(path);
+}
+
+static void json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void write_json(FILE *out, const char *label, double seconds,
+                       const bench_run_t *runs, size_t num_runs) {
+    char when[32];
+    time_t now = time(NULL);
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+    fprintf(out, "{\n  \"suite\": \"restinio_c_bench\",\n  \"label\": ");
+    json_string(out, label);
+    fprintf(out, ",\n  \"time\": \"%s\",\n  \"cpus\": %ld,\n  \"seconds_per_case\": %.1f,\n"
+                 "  \"allocations_counted\": %s,\n  \"cases\": [\n",
+            when, sysconf(_SC_NPROCESSORS_ONLN), seconds, COUNT_ALLOCATIONS ? "true" : "false");
+    for (size_t i = 0; i < num_runs; i++) {
+        const bench_run_t *r = runs + i;
+        fprintf(out, "    {\"name\": ");
+        json_string(out, r->test->name);
+        fprintf(out, ", \"method\": \"%s\", \"target\": ", r->test->method);
+        json_string(out, r->test->target);
+        fprintf(out, ", \"connections\": %d, \"pipeline\": %d, \"keepalive\": %s, "
+                     "\"body_bytes\": %zu, \"requests\": %llu, \"errors\": %llu, "
+                     "\"requests_per_second\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+                     "\"p999_us\": %.1f, \"allocations_per_request\": ",
+                r->connections, r->test->pipeline,
+                r->test->new_connection_per_request ? "false" : "true",
+                r->test->body_length,
+                (unsigned long long)r->result.requests,
+                (unsigned long long)r->result.errors,
+                r->result.requests_per_second,
+                r->result.p50_us, r->result.p99_us, r->result.p999_us);
+        if (COUNT_ALLOCATIONS)
+            fprintf(out, "%.2f}", r->allocations_per_request);
+        else
+            fprintf(out, "null}");
+        fprintf(out, "%s\n", i + 1 < num_runs ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--seconds S] [--connections N] [--port P] "
+            "[--filter SUBSTRING] [--label TEXT] [--json FILE]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    double seconds = 2.0;
+    int connections = 32;
+    unsigned short port = 18090;
+    const char *filter = NULL;
+    const char *label = "";
+    const char *json_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        const char *value = argv[++i];
+        if (!strcmp(arg, "--seconds"))
+            seconds = atof(value);
+        else if (!strcmp(arg, "--connections"))
+            connections = atoi(value);
+        else if (!strcmp(arg, "--port"))
+            port = (unsigned short)atoi(value);
+        else if (!strcmp(arg, "--filter"))
+            filter = value;
+        else if (!strcmp(arg, "--label"))
+            label = value;
+        else if (!strcmp(arg, "--json"))
+            json_path = value;
+        else
+            usage(argv[0]);
+    }
+
+    char dir[] = "/tmp/restinio_c_benchXXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    write_file(dir, "small.html", 2 * 1024);
+    write_file(dir, "large.bin", 1024 * 1024);
+
+    restinio_options_t options = {
+        .enable_keepalive = true,
+        .enable_thread_pool = true,
+        .thread_pool_size = 4,
+        .port = port,
+        .address = "127.0.0.1",
+        .max_pipelined_requests = 16
+    };
+    restinio_server_t *server = restinio_server_create(&options);
+    restinio_path_handler_t *files = restinio_path_handler(dir, "/static", true);
+    restinio_path_handler_cache(files, 32 * 1024 * 1024, 512 * 1024);
+
+    restinio_server_use_view(server, "GET", "/sync", sync_handler, NULL);
+    restinio_header_t content_type = { "Content-Type", "text/plain", NULL };
+    restinio_server_use_static(server, "GET", "/health", 200, &content_type, "pong", 4);
+    restinio_server_use_view(server, "POST", "/echo", echo_handler, NULL);
+    restinio_server_use_detached_view(server, "GET", "/detached", detached_handler, NULL);
+    restinio_server_use_view(server, "GET", "/static", restinio_path_handler_view_cb, files);
+    if (!restinio_server_run(server) || !bench_wait_for_port("127.0.0.1", port, 5.0)) {
+        fprintf(stderr, "server did not start on port %u\n", port);
+        return 1;
+    }
+
+    size_t num_cases = sizeof(cases) / sizeof(cases[0]);
+    bench_run_t *runs = (bench_run_t *)calloc(num_cases, sizeof(bench_run_t));
+    size_t num_runs = 0;
+    char *body = (char *)malloc(65536);
+    memset(body, 'x', 65536);
+
+    for (size_t i = 0; i < num_cases; i++) {
+        const bench_case_t *test = cases + i;
+        if (filter && !strstr(test->name, filter))
+            continue;
+        bench_client_options_t client = {
+            .port = port,
+            .method = test->method,
+            .target = test->target,
+            .body = body,
+            .body_length = test->body_length,
+            .connections = connections,
+            .pipeline = test->pipeline,
+            .seconds = seconds,
+            .new_connection_per_request = test->new_connection_per_request
+        };
+        bench_run_t *run = runs + num_runs++;
+        run->test = test;
+        run->connections = connections;
+
+        uint64_t before = allocation_count();
+        bench_client_run(&client, &run->result);
+        uint64_t allocated = allocation_count() - before;
+        if (run->result.requests)
+            run->allocations_per_request = (double)allocated / (double)run->result.requests;
+
+        bench_print_result(test->name, &run->result);
+        if (COUNT_ALLOCATIONS)
+            printf("%-28s %10.2f allocations/request\n", "", run->allocations_per_request);
+    }
+
+    restinio_server_destroy(server);
+
+    int rc = 0;
+    if (json_path) {
+        FILE *out = fopen(json_path, "w");
+        if (out) {
+            write_json(out, label, seconds, runs, num_runs);
+            fclose(out);
+        } else {
+            perror(json_path);
+            rc = 1;
+        }
+    }
+
+    free(body);
+    free(runs);
+    remove_file(dir, "small.html");
+    remove_file(dir, "large.bin");
+    rmdir(dir);
+    return rc;
+}
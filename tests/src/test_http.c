@@ -0,0 +1,191 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Header parsers behind content negotiation, conditional requests and
+// byte ranges.
+
+#include "restinio_http.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static int failures;
+
+#define CHECK(cond, ...)                                                 \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);   \
+            fprintf(stderr, __VA_ARGS__);                                \
+            fputc('\n', stderr);                                         \
+            failures++;                                                  \
+        }                                                                \
+    } while (0)
+
+static void check_accepts(const char *header, const char *coding, bool expected) {
+    bool actual = restinio_http_accepts_encoding(header, strlen(header), coding);
+    CHECK(actual == expected, "Accept-Encoding: %s, %s -> %d", header, coding, actual);
+}
+
+static void test_accepts_encoding(void) {
+    check_accepts("gzip", "gzip", true);
+    check_accepts("GZip", "gzip", true);
+    check_accepts("deflate, gzip;q=0.5", "gzip", true);
+    check_accepts("deflate", "gzip", false);
+    check_accepts("", "gzip", false);
+    check_accepts("gzip;q=0", "gzip", false);
+    check_accepts("gzip; q=0.000", "gzip", false);
+    check_accepts("gzip;Q=0.001", "gzip", true);
+    check_accepts("gzip;q=0.", "gzip", false);
+    check_accepts("gzipx, xgzip", "gzip", false);
+    check_accepts("*", "zstd", true);
+    check_accepts("*;q=0", "zstd", false);
+    // an explicit entry wins over the wildcard, in either order
+    check_accepts("*;q=0, gzip", "gzip", true);
+    check_accepts("gzip;q=0, *", "gzip", false);
+    // identity is acceptable unless ruled out
+    check_accepts("gzip", "identity", true);
+    check_accepts("", "identity", true);
+    check_accepts("identity;q=0", "identity", false);
+    check_accepts("*;q=0", "identity", false);
+    check_accepts("*;q=0, identity", "identity", true);
+    // parameters other than q are skipped
+    check_accepts("gzip;level=1;q=0", "gzip", false);
+    check_accepts(" ,, gzip ,", "gzip", true);
+}
+
+static void check_etag(const char *header, const char *etag, bool expected) {
+    bool actual = restinio_http_etag_matches(header, strlen(header), etag, strlen(etag));
+    CHECK(actual == expected, "If-None-Match: %s, ETag %s -> %d", header, etag, actual);
+}
+
+static void test_etag_matches(void) {
+    check_etag("\"abc\"", "\"abc\"", true);
+    check_etag("\"abc\"", "\"abd\"", false);
+    check_etag("\"ab\"", "\"abc\"", false);
+    // the weak comparison ignores W/ on either side
+    check_etag("W/\"abc\"", "\"abc\"", true);
+    check_etag("\"abc\"", "W/\"abc\"", true);
+    check_etag("\"x\", \"y\",W/\"abc\"", "\"abc\"", true);
+    check_etag("  \"x\" ,\t\"abc\"\t", "\"abc\"", true);
+    check_etag("*", "\"anything\"", true);
+    check_etag("\"*\"", "\"abc\"", false);
+    // commas inside a quoted tag do not split it
+    check_etag("\"a,b\"", "\"a,b\"", true);
+    check_etag("\"a,b\"", "\"a\"", false);
+    check_etag("", "\"abc\"", false);
+    check_etag(",,", "\"abc\"", false);
+}
+
+static void test_dates(void) {
+    time_t t;
+    CHECK(restinio_http_parse_date("Sun, 06 Nov 1994 08:49:37 GMT", &t) && t == 784111777,
+          "IMF-fixdate");
+    char buf[40];
+    restinio_http_format_date(784111777, buf, sizeof(buf));
+    CHECK(!strcmp(buf, "Sun, 06 Nov 1994 08:49:37 GMT"), "formatted %s", buf);
+    restinio_http_format_date(0, buf, sizeof(buf));
+    CHECK(restinio_http_parse_date(buf, &t) && t == 0, "round trip of %s", buf);
+
+    // obsolete RFC 850 and asctime forms, and garbage, are no date at all
+    CHECK(!restinio_http_parse_date("Sunday, 06-Nov-94 08:49:37 GMT", &t), "RFC 850");
+    CHECK(!restinio_http_parse_date("Sun Nov  6 08:49:37 1994", &t), "asctime");
+    CHECK(!restinio_http_parse_date("Sun, 06 Foo 1994 08:49:37 GMT", &t), "bad month");
+    CHECK(!restinio_http_parse_date("Sun, 06 ovD 1994 08:49:37 GMT", &t), "month across names");
+    CHECK(!restinio_http_parse_date("", &t), "empty");
+}
+
+// expected is "first-last,first-last" or "" for 416; NULL for -1
+static void check_ranges(const char *header, uint64_t size, const char *expected) {
+    restinio_byte_range_t ranges[RESTINIO_HTTP_MAX_RANGES];
+    int n = restinio_http_parse_ranges(header, size, ranges);
+    char actual[512] = "";
+    for (int i = 0; i < n; i++)
+        snprintf(actual + strlen(actual), sizeof(actual) - strlen(actual), "%s%llu-%llu",
+                 i ? "," : "", (unsigned long long)ranges[i].first,
+                 (unsigned long long)ranges[i].last);
+    if (!expected)
+        CHECK(n == -1, "Range: %s of %llu -> %d (%s)", header, (unsigned long long)size, n, actual);
+    else
+        CHECK(n >= 0 && !strcmp(actual, expected), "Range: %s of %llu -> %d (%s), want %s",
+              header, (unsigned long long)size, n, actual, expected);
+}
+
+static void test_ranges(void) {
+    check_ranges("bytes=0-99", 1000, "0-99");
+    check_ranges("BYTES=0-0", 1000, "0-0");
+    check_ranges("bytes=990-", 1000, "990-999");
+    check_ranges("bytes=-50", 1000, "950-999");
+    check_ranges("bytes=-5000", 1000, "0-999");
+    check_ranges("bytes=900-2000", 1000, "900-999");
+    check_ranges("bytes=0-9, 20-29 ,-1", 1000, "0-9,20-29,999-999");
+    // unsatisfiable specs are dropped; none left means 416
+    check_ranges("bytes=1000-", 1000, "");
+    check_ranges("bytes=5-9,2000-3000", 1000, "5-9");
+    check_ranges("bytes=-0", 1000, "");
+    check_ranges("bytes=0-", 0, "");
+    check_ranges("bytes=-10", 0, "");
+    // malformed or too long: the whole representation is sent
+    check_ranges("items=0-9", 1000, NULL);
+    check_ranges("bytes=", 1000, NULL);
+    check_ranges("bytes=9-0", 1000, NULL);
+    check_ranges("bytes=a-9", 1000, NULL);
+    check_ranges("bytes=0-9;", 1000, NULL);
+    check_ranges("bytes=0-9,", 1000, NULL);
+    check_ranges("bytes=-", 1000, NULL);
+    check_ranges("bytes=99999999999999999999-", 1000, NULL);
+    check_ranges("bytes=0-0,1-1,2-2,3-3,4-4,5-5,6-6,7-7,8-8,9-9,10-10,11-11,12-12,13-13,14-14,15-15",
+                 1000, "0-0,1-1,2-2,3-3,4-4,5-5,6-6,7-7,8-8,9-9,10-10,11-11,12-12,13-13,14-14,15-15");
+    check_ranges("bytes=0-0,1-1,2-2,3-3,4-4,5-5,6-6,7-7,8-8,9-9,10-10,11-11,12-12,13-13,14-14,15-15,16-16",
+                 1000, NULL);
+}
+
+static void test_if_range(void) {
+    time_t modified = 784111777;
+    CHECK(restinio_http_if_range_matches("\"abc\"", "\"abc\"", modified), "same tag");
+    CHECK(!restinio_http_if_range_matches("\"abd\"", "\"abc\"", modified), "other tag");
+    // If-Range uses the strong comparison: a weak tag never matches
+    CHECK(!restinio_http_if_range_matches("W/\"abc\"", "\"abc\"", modified), "weak tag");
+    CHECK(restinio_http_if_range_matches("Sun, 06 Nov 1994 08:49:37 GMT", "\"abc\"", modified),
+          "exact date");
+    CHECK(!restinio_http_if_range_matches("Sun, 06 Nov 1994 08:49:38 GMT", "\"abc\"", modified),
+          "later date");
+    CHECK(!restinio_http_if_range_matches("yesterday", "\"abc\"", modified), "not a date");
+}
+
+static void test_range_parts(void) {
+    restinio_byte_range_t range = {10, 19};
+    char buf[256];
+    size_t n = restinio_http_range_part(buf, sizeof(buf), "B", "text/plain", &range, 100, true);
+    const char *first = "--B\r\nContent-Type: text/plain\r\nContent-Range: bytes 10-19/100\r\n\r\n";
+    CHECK(n == strlen(first) && !strcmp(buf, first), "first part: %s", buf);
+
+    n = restinio_http_range_part(buf, sizeof(buf), "B", "text/plain", &range, 100, false);
+    CHECK(n == strlen(first) + 2 && !strncmp(buf, "\r\n", 2) && !strcmp(buf + 2, first),
+          "later part: %s", buf);
+
+    n = restinio_http_range_part(buf, sizeof(buf), "B", NULL, NULL, 100, false);
+    CHECK(n == 9 && !strcmp(buf, "\r\n--B--\r\n"), "closing delimiter: %s", buf);
+
+    // a part that does not fit is cut to the buffer, never past it
+    n = restinio_http_range_part(buf, 16, "B", "text/plain", &range, 100, true);
+    CHECK(n == 15 && strlen(buf) == 15, "truncated to %zu", n);
+}
+
+int main(void) {
+    test_accepts_encoding();
+    test_etag_matches();
+    test_dates();
+    test_ranges();
+    test_if_range();
+    test_range_parts();
+
+    if (failures) {
+        fprintf(stderr, "%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("http header parsers ok\n");
+    return 0;
+}
@@ -0,0 +1,315 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Response cache: hits, misses coalescing behind their leader, TTL expiry,
+// least recently used eviction within the byte budget, and many threads
+// sharing one key space.
+
+#include "restinio_response_cache.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int failures;
+
+#define CHECK(cond, ...)                                                 \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);   \
+            fprintf(stderr, __VA_ARGS__);                                \
+            fputc('\n', stderr);                                         \
+            failures++;                                                  \
+        }                                                                \
+    } while (0)
+
+static const char headers[] = "ETag\0\"x\"\0Content-Type\0text/plain";
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+    nanosleep(&ts, NULL);
+}
+
+// waiters are heap ints so ASan catches one served twice or never
+static void *make_waiter(void *arg) {
+    int *waiter = (int *)malloc(sizeof(int));
+    if (waiter)
+        *waiter = *(const int *)arg;
+    return waiter;
+}
+
+static atomic_int served, served_null, served_bad;
+
+static bool is_hello(const restinio_cached_response_t *entry) {
+    return entry->status == 200 && entry->body_length == 5 &&
+           !memcmp(entry->body, "hello", 5) && entry->etag && !strcmp(entry->etag, "\"x\"");
+}
+
+static void serve(void *waiter, const restinio_cached_response_t *entry, void *arg) {
+    (void)arg;
+    if (!entry)
+        atomic_fetch_add(&served_null, 1);
+    else if (!is_hello(entry))
+        atomic_fetch_add(&served_bad, 1);
+    atomic_fetch_add(&served, 1);
+    free(waiter);
+}
+
+static void reset_served(void) {
+    atomic_store(&served, 0);
+    atomic_store(&served_null, 0);
+    atomic_store(&served_bad, 0);
+}
+
+static restinio_cache_result_t lookup(restinio_response_cache_t *cache, const char *key,
+                                      const restinio_cached_response_t **entry,
+                                      restinio_cache_pending_t **pending) {
+    static const int id = 0;
+    return restinio_response_cache_lookup(cache, key, strlen(key), make_waiter, (void *)&id,
+                                          entry, pending);
+}
+
+// "hello" from the leader, with an ETag; the leader's reference is dropped
+static void fill(restinio_response_cache_t *cache, restinio_cache_pending_t *pending,
+                 bool store) {
+    struct iovec body[2] = { { (void *)"hel", 3 }, { (void *)"lo", 2 } };
+    const restinio_cached_response_t *entry = restinio_response_cache_fill(
+        cache, pending, 200, headers, sizeof(headers), 2, body, 2, store, serve, NULL);
+    CHECK(entry && is_hello(entry), "the leader's entry");
+    if (entry)
+        restinio_cached_response_release(entry);
+}
+
+static bool is_cached(restinio_response_cache_t *cache, const char *key) {
+    const restinio_cached_response_t *entry;
+    restinio_cache_pending_t *pending;
+    if (lookup(cache, key, &entry, &pending) == RESTINIO_CACHE_HIT) {
+        restinio_cached_response_release(entry);
+        return true;
+    }
+    if (pending)
+        restinio_response_cache_abandon(cache, pending, serve, NULL);
+    return false;
+}
+
+static void test_hit_and_coalesce(void) {
+    reset_served();
+    restinio_response_cache_t *cache = restinio_response_cache_create(1 << 20, 0);
+    const restinio_cached_response_t *entry;
+    restinio_cache_pending_t *leader, *pending;
+    CHECK(lookup(cache, "GET /a", &entry, &leader) == RESTINIO_CACHE_MISS && leader,
+          "first lookup leads");
+    for (int i = 0; i < 3; i++)
+        CHECK(lookup(cache, "GET /a", &entry, &pending) == RESTINIO_CACHE_WAIT,
+              "concurrent miss %d waits", i);
+    CHECK(atomic_load(&served) == 0, "waiters served before the fill");
+    fill(cache, leader, true);
+    CHECK(atomic_load(&served) == 3 && atomic_load(&served_null) == 0 &&
+          atomic_load(&served_bad) == 0, "served %d (%d NULL, %d wrong)",
+          atomic_load(&served), atomic_load(&served_null), atomic_load(&served_bad));
+
+    CHECK(lookup(cache, "GET /a", &entry, &pending) == RESTINIO_CACHE_HIT && is_hello(entry),
+          "hit after the fill");
+    if (entry)
+        restinio_cached_response_release(entry);
+    CHECK(!is_cached(cache, "GET /b"), "another key");
+
+    restinio_cache_stats_t stats;
+    restinio_response_cache_stats(cache, &stats);
+    CHECK(stats.hits == 1 && stats.misses == 2 && stats.coalesced == 3 && stats.stores == 1 &&
+          stats.entries == 1, "hits %llu misses %llu coalesced %llu stores %llu entries %zu",
+          (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+          (unsigned long long)stats.coalesced, (unsigned long long)stats.stores, stats.entries);
+    restinio_response_cache_destroy(cache);
+}
+
+// an unstorable response still reaches the waiters; an abandoned miss
+// hands them NULL
+static void test_no_store_and_abandon(void) {
+    reset_served();
+    restinio_response_cache_t *cache = restinio_response_cache_create(1 << 20, 0);
+    const restinio_cached_response_t *entry;
+    restinio_cache_pending_t *leader, *pending;
+    lookup(cache, "GET /private", &entry, &leader);
+    lookup(cache, "GET /private", &entry, &pending);
+    fill(cache, leader, false);
+    CHECK(atomic_load(&served) == 1 && atomic_load(&served_null) == 0, "waiter of a no-store");
+    CHECK(!is_cached(cache, "GET /private"), "a no-store response was stored");
+
+    reset_served();
+    lookup(cache, "GET /gone", &entry, &leader);
+    lookup(cache, "GET /gone", &entry, &pending);
+    lookup(cache, "GET /gone", &entry, &pending);
+    restinio_response_cache_abandon(cache, leader, serve, NULL);
+    CHECK(atomic_load(&served) == 2 && atomic_load(&served_null) == 2,
+          "abandoned: served %d, %d NULL", atomic_load(&served), atomic_load(&served_null));
+    CHECK(!is_cached(cache, "GET /gone"), "an abandoned miss was stored");
+
+    restinio_cache_stats_t stats;
+    restinio_response_cache_stats(cache, &stats);
+    CHECK(stats.stores == 0 && stats.entries == 0 && stats.bytes == 0,
+          "stores %llu entries %zu bytes %zu",
+          (unsigned long long)stats.stores, stats.entries, stats.bytes);
+    restinio_response_cache_destroy(cache);
+}
+
+static void test_ttl(void) {
+    restinio_response_cache_t *cache = restinio_response_cache_create(1 << 20, 20);
+    const restinio_cached_response_t *entry;
+    restinio_cache_pending_t *leader;
+    lookup(cache, "GET /ttl", &entry, &leader);
+    fill(cache, leader, true);
+    CHECK(is_cached(cache, "GET /ttl"), "fresh entry");
+    sleep_ms(40);
+    CHECK(!is_cached(cache, "GET /ttl"), "entry outlived its ttl");
+
+    restinio_cache_stats_t stats;
+    restinio_response_cache_stats(cache, &stats);
+    CHECK(stats.expirations == 1 && stats.entries == 0, "expirations %llu entries %zu",
+          (unsigned long long)stats.expirations, stats.entries);
+    restinio_response_cache_destroy(cache);
+}
+
+static void store(restinio_response_cache_t *cache, const char *key,
+                  const char *body, size_t body_length) {
+    const restinio_cached_response_t *entry;
+    restinio_cache_pending_t *leader;
+    CHECK(lookup(cache, key, &entry, &leader) == RESTINIO_CACHE_MISS && leader, "miss on %s", key);
+    if (!leader)
+        return;
+    struct iovec iov = { (void *)body, body_length };
+    restinio_cached_response_release(restinio_response_cache_fill(
+        cache, leader, 200, "", 0, 0, &iov, 1, true, serve, NULL));
+}
+
+static void test_eviction(void) {
+    // the budget is charged per entry, header included: measure one
+    restinio_response_cache_t *cache = restinio_response_cache_create(1 << 20, 0);
+    store(cache, "k0", "0123456789", 10);
+    restinio_cache_stats_t stats;
+    restinio_response_cache_stats(cache, &stats);
+    size_t entry_size = stats.bytes;
+    restinio_response_cache_destroy(cache);
+
+    // room for three, wherever the keys' shards are: the budget and the
+    // recency order are the cache's, not a shard's
+    cache = restinio_response_cache_create(3 * entry_size, 0);
+    store(cache, "k0", "0123456789", 10);
+    sleep_ms(2);
+    store(cache, "k1", "0123456789", 10);
+    sleep_ms(2);
+    store(cache, "k2", "0123456789", 10);
+    sleep_ms(2);
+    CHECK(is_cached(cache, "k0"), "k0 before the eviction");
+    sleep_ms(2);
+    store(cache, "k3", "0123456789", 10);
+    CHECK(!is_cached(cache, "k1"), "the least recently used entry survived");
+    CHECK(is_cached(cache, "k0") && is_cached(cache, "k2") && is_cached(cache, "k3"),
+          "a recently used entry was evicted");
+    restinio_response_cache_stats(cache, &stats);
+    CHECK(stats.evictions == 1 && stats.entries == 3 && stats.bytes <= 3 * entry_size,
+          "evictions %llu entries %zu bytes %zu",
+          (unsigned long long)stats.evictions, stats.entries, stats.bytes);
+
+    // many keys: never over budget
+    for (int i = 0; i < 1000; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "m%d", i);
+        store(cache, key, "0123456789", 10);
+    }
+    restinio_response_cache_stats(cache, &stats);
+    CHECK(stats.bytes <= 3 * entry_size && stats.entries <= 3, "entries %zu bytes %zu",
+          stats.entries, stats.bytes);
+    restinio_response_cache_destroy(cache);
+
+    // one entry may use most of the budget, whatever the shard count; one
+    // larger than the whole budget is not stored
+    static char big[3000], huge[5000];
+    cache = restinio_response_cache_create(4096, 0);
+    store(cache, "big", big, sizeof(big));
+    CHECK(is_cached(cache, "big"), "an entry within max_bytes was not stored");
+    store(cache, "huge", huge, sizeof(huge));
+    CHECK(!is_cached(cache, "huge"), "an entry over max_bytes was stored");
+    restinio_response_cache_stats(cache, &stats);
+    CHECK(stats.stores == 1 && stats.entries == 1 && stats.bytes <= 4096,
+          "stores %llu entries %zu bytes %zu",
+          (unsigned long long)stats.stores, stats.entries, stats.bytes);
+    restinio_response_cache_destroy(cache);
+}
+
+#define THREADS 8
+#define LOOKUPS 20000
+
+static restinio_response_cache_t *shared;
+static atomic_int answered, bad_hits;
+
+static void *hammer(void *arg) {
+    int id = (int)(intptr_t)arg;
+    for (int i = 0; i < LOOKUPS; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "GET /k%d", i % 64);
+        const restinio_cached_response_t *entry;
+        restinio_cache_pending_t *leader;
+        switch (restinio_response_cache_lookup(shared, key, strlen(key), make_waiter, &id,
+                                               &entry, &leader)) {
+        case RESTINIO_CACHE_HIT:
+            if (!is_hello(entry))
+                atomic_fetch_add(&bad_hits, 1);
+            restinio_cached_response_release(entry);
+            atomic_fetch_add(&answered, 1);
+            break;
+        case RESTINIO_CACHE_WAIT:
+            break;      // counted in served
+        case RESTINIO_CACHE_MISS:
+            atomic_fetch_add(&answered, 1);
+            if (leader)
+                fill(shared, leader, true);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void test_threads(void) {
+    reset_served();
+    // a short ttl keeps misses, and so coalescing, coming
+    shared = restinio_response_cache_create(1 << 20, 2);
+    pthread_t threads[THREADS];
+    for (int i = 0; i < THREADS; i++)
+        pthread_create(&threads[i], NULL, hammer, (void *)(intptr_t)i);
+    for (int i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    int total = atomic_load(&answered) + atomic_load(&served);
+    CHECK(total == THREADS * LOOKUPS, "answered %d of %d", total, THREADS * LOOKUPS);
+    CHECK(atomic_load(&bad_hits) == 0 && atomic_load(&served_bad) == 0 &&
+          atomic_load(&served_null) == 0, "%d bad hits, %d bad and %d NULL waiters",
+          atomic_load(&bad_hits), atomic_load(&served_bad), atomic_load(&served_null));
+    restinio_cache_stats_t stats;
+    restinio_response_cache_stats(shared, &stats);
+    CHECK(stats.hits + stats.misses + stats.coalesced == THREADS * LOOKUPS,
+          "hits %llu + misses %llu + coalesced %llu",
+          (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+          (unsigned long long)stats.coalesced);
+    restinio_response_cache_destroy(shared);
+}
+
+int main(void) {
+    test_hit_and_coalesce();
+    test_no_store_and_abandon();
+    test_ttl();
+    test_eviction();
+    test_threads();
+
+    if (failures) {
+        fprintf(stderr, "%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("response cache ok\n");
+    return 0;
+}
@@ -0,0 +1,164 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Checks the frozen route table against the linear g_path_map walk it
+// replaced: for random route sets, every target must yield the same
+// matching routes in the same (registration) order, so the first match and
+// every fall-through after it agree.
+
+#include "restinio_route_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_ROUNDS 2000
+#define MAX_ROUTES 24
+
+// Short, overlapping pieces so that prefixes, exact matches and segment
+// boundaries collide often
+static const char *segments[] = { "/a", "/ab", "/b", "/api", "/v1", "/", "/{id}", "x" };
+#define NUM_SEGMENTS (sizeof(segments) / sizeof(segments[0]))
+
+// Standard verbs, registered extra verbs ("get" is not GET) and the
+// match-all ""; requests may also use a verb nobody registered
+static const char *methods[] = { "", "GET", "HEAD", "POST", "DELETE", "PURGE", "LINK", "get" };
+#define NUM_METHODS (sizeof(methods) / sizeof(methods[0]))
+static const char *request_methods[] = { "GET", "HEAD", "POST", "DELETE", "PURGE", "LINK", "get", "BREW" };
+#define NUM_REQUEST_METHODS (sizeof(request_methods) / sizeof(request_methods[0]))
+
+static int failures;
+
+#define CHECK(cond, ...)                                                 \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);   \
+            fprintf(stderr, __VA_ARGS__);                                \
+            fputc('\n', stderr);                                         \
+            failures++;                                                  \
+        }                                                                \
+    } while (0)
+
+static void random_path(char *buf, size_t size, size_t max_segments) {
+    buf[0] = '\0';
+    size_t n = (size_t)rand() % (max_segments + 1);
+    for (size_t i = 0; i < n; i++)
+        strncat(buf, segments[rand() % NUM_SEGMENTS], size - strlen(buf) - 1);
+}
+
+// The pre-table dispatch: method "" or equal, path "" or a prefix of the
+// target.  Pattern routes compare their literal prefix and then capture.
+static size_t linear_matches(const restinio_route_table_t *table,
+                             const restinio_route_spec_t *routes, size_t num_routes,
+                             const char *method, const char *target,
+                             uint32_t *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < num_routes; i++) {
+        const char *path = routes[i].path;
+        const char *brace = strchr(path, '{');
+        size_t literal = brace ? (size_t)(brace - path) : strlen(path);
+        if (routes[i].method[0] && strcmp(method, routes[i].method))
+            continue;
+        if (strncmp(target, path, literal))
+            continue;
+        restinio_route_param_t params[RESTINIO_ROUTE_MAX_PARAMS];
+        size_t num_params;
+        if (brace && !restinio_route_table_capture(table, (uint32_t)i, target, strlen(target),
+                                                   params, &num_params))
+            continue;
+        out[n++] = (uint32_t)i;
+    }
+    return n;
+}
+
+static size_t table_matches(const restinio_route_table_t *table,
+                            const char *method, const char *target, uint32_t *out) {
+    const uint32_t *candidates;
+    size_t num_candidates = restinio_route_table_match(table, method, strlen(method),
+                                                       target, strlen(target), &candidates);
+    size_t n = 0;
+    for (size_t i = 0; i < num_candidates; i++) {
+        restinio_route_param_t params[RESTINIO_ROUTE_MAX_PARAMS];
+        size_t num_params;
+        if (restinio_route_table_capture(table, candidates[i], target, strlen(target),
+                                         params, &num_params))
+            out[n++] = candidates[i];
+    }
+    return n;
+}
+
+static void check_target(const restinio_route_table_t *table,
+                         const restinio_route_spec_t *routes, size_t num_routes,
+                         const char *method, const char *target) {
+    uint32_t expected[MAX_ROUTES], actual[MAX_ROUTES];
+    size_t num_expected = linear_matches(table, routes, num_routes, method, target, expected);
+    size_t num_actual = table_matches(table, method, target, actual);
+    CHECK(num_expected == num_actual && !memcmp(expected, actual, num_actual * sizeof(uint32_t)),
+          "%s %s: %zu linear matches (first %d), %zu from the table (first %d)",
+          method, target, num_expected, num_expected ? (int)expected[0] : -1,
+          num_actual, num_actual ? (int)actual[0] : -1);
+}
+
+static void run_round(void) {
+    char paths[MAX_ROUTES][64];
+    restinio_route_spec_t routes[MAX_ROUTES];
+    size_t num_routes = 1 + (size_t)rand() % MAX_ROUTES;
+    for (size_t i = 0; i < num_routes; i++) {
+        random_path(paths[i], sizeof(paths[i]), 3);
+        // duplicates and shadowed routes are kept: order must still hold
+        if (i && rand() % 8 == 0)
+            strcpy(paths[i], paths[rand() % i]);
+        routes[i].method = methods[rand() % NUM_METHODS];
+        routes[i].path = paths[i];
+    }
+
+    restinio_route_table_t *table = restinio_route_table_build(routes, num_routes);
+    CHECK(table != NULL, "build failed for %zu routes", num_routes);
+    if (!table)
+        return;
+
+    for (size_t t = 0; t < 40; t++) {
+        char target[128];
+        const char *method = request_methods[rand() % NUM_REQUEST_METHODS];
+        switch (rand() % 3) {
+        case 0:
+            // exactly a registered path
+            snprintf(target, sizeof(target), "%s", paths[rand() % num_routes]);
+            break;
+        case 1:
+            // a registered path with more after it
+            snprintf(target, sizeof(target), "%s%s%s", paths[rand() % num_routes],
+                     segments[rand() % NUM_SEGMENTS], rand() % 2 ? "?q=1" : "");
+            break;
+        default:
+            random_path(target, sizeof(target), 4);
+            break;
+        }
+        check_target(table, routes, num_routes, method, target);
+    }
+    restinio_route_table_destroy(table);
+}
+
+int main(void) {
+    srand(12345);
+    for (int i = 0; i < NUM_ROUNDS; i++)
+        run_round();
+
+    // an empty table matches nothing
+    restinio_route_table_t *table = restinio_route_table_build(NULL, 0);
+    CHECK(table != NULL, "build failed for no routes");
+    if (table) {
+        const uint32_t *candidates;
+        CHECK(restinio_route_table_match(table, "GET", 3, "/", 1, &candidates) == 0,
+              "match in an empty table");
+        restinio_route_table_destroy(table);
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("route table matches the linear walk over %d random route sets\n", NUM_ROUNDS);
+    return 0;
+}
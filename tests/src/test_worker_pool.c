@@ -0,0 +1,142 @@
+// SPDX-FileCopyrightText: 2025 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai — technical questions: contact Andy (above)
+// SPDX-License-Identifier: Apache-2.0
+
+// Worker pool: every submitted item runs exactly once, idle workers wake
+// for work trickling in, full queues reject, and cancel hands queued items
+// back without running them.
+
+#include "restinio_worker_pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+static int failures;
+
+#define CHECK(cond, ...)                                                 \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);   \
+            fprintf(stderr, __VA_ARGS__);                                \
+            fputc('\n', stderr);                                         \
+            failures++;                                                  \
+        }                                                                \
+    } while (0)
+
+static atomic_size_t ran, cancelled;
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+    nanosleep(&ts, NULL);
+}
+
+static void count_run(void *arg) {
+    (void)arg;
+    atomic_fetch_add(&ran, 1);
+}
+
+static void count_cancel(void *arg) {
+    (void)arg;
+    atomic_fetch_add(&cancelled, 1);
+}
+
+// holds a worker until the gate opens
+static atomic_bool gate_open;
+static void wait_for_gate(void *arg) {
+    (void)arg;
+    while (!atomic_load(&gate_open))
+        sleep_ms(1);
+    atomic_fetch_add(&ran, 1);
+}
+
+static bool wait_for(atomic_size_t *counter, size_t expected) {
+    for (int i = 0; i < 5000 && atomic_load(counter) != expected; i++)
+        sleep_ms(1);
+    return atomic_load(counter) == expected;
+}
+
+static void *submitter(void *arg) {
+    restinio_worker_pool_t *pool = (restinio_worker_pool_t *)arg;
+    for (int i = 0; i < 10000; i++) {
+        while (!restinio_worker_pool_submit(pool, count_run, NULL))
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void test_runs_everything(void) {
+    atomic_store(&ran, 0);
+    restinio_worker_pool_t *pool = restinio_worker_pool_create(4, 64);
+    CHECK(pool != NULL, "create");
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++)
+        pthread_create(&threads[i], NULL, submitter, pool);
+    for (int i = 0; i < 4; i++)
+        pthread_join(threads[i], NULL);
+    CHECK(wait_for(&ran, 40000), "ran %zu of 40000", atomic_load(&ran));
+    restinio_worker_pool_destroy(pool);
+}
+
+// one item at a time, each after the workers have gone back to sleep
+static void test_wakes_idle_workers(void) {
+    atomic_store(&ran, 0);
+    restinio_worker_pool_t *pool = restinio_worker_pool_create(2, 4);
+    for (size_t i = 1; i <= 50; i++) {
+        CHECK(restinio_worker_pool_submit(pool, count_run, NULL), "submit %zu", i);
+        CHECK(wait_for(&ran, i), "item %zu was not picked up", i);
+        if (i % 10 == 0)
+            sleep_ms(5);
+    }
+    restinio_worker_pool_destroy(pool);
+}
+
+static void test_full_and_cancel(void) {
+    atomic_store(&ran, 0);
+    atomic_store(&cancelled, 0);
+    atomic_store(&gate_open, false);
+    restinio_worker_pool_t *pool = restinio_worker_pool_create(1, 3);
+    CHECK(restinio_worker_pool_submit(pool, wait_for_gate, NULL), "submit the blocker");
+    restinio_worker_pool_stats_t stats;
+    for (int i = 0; i < 1000; i++) {
+        restinio_worker_pool_stats(pool, &stats);
+        if (stats.running == 1)
+            break;
+        sleep_ms(1);
+    }
+    CHECK(stats.running == 1, "the blocker is not running");
+
+    for (int i = 0; i < 3; i++)
+        CHECK(restinio_worker_pool_submit(pool, count_run, NULL), "queue item %d", i);
+    CHECK(!restinio_worker_pool_submit(pool, count_run, NULL), "a full queue accepted work");
+    restinio_worker_pool_stats(pool, &stats);
+    CHECK(stats.queued == 3 && stats.rejected == 1, "queued %zu, rejected %llu",
+          stats.queued, (unsigned long long)stats.rejected);
+
+    size_t n = restinio_worker_pool_cancel(pool, count_cancel);
+    CHECK(n == 3 && atomic_load(&cancelled) == 3, "cancelled %zu (%zu calls)",
+          n, atomic_load(&cancelled));
+    restinio_worker_pool_stats(pool, &stats);
+    CHECK(stats.queued == 0, "%zu still queued", stats.queued);
+
+    atomic_store(&gate_open, true);
+    restinio_worker_pool_destroy(pool);
+    CHECK(atomic_load(&ran) == 1, "ran %zu, only the blocker should have", atomic_load(&ran));
+}
+
+int main(void) {
+    CHECK(restinio_worker_pool_create(0, 4) == NULL, "no threads");
+    CHECK(restinio_worker_pool_create(4, 0) == NULL, "no queue");
+    test_runs_everything();
+    test_wakes_idle_workers();
+    test_full_and_cancel();
+
+    if (failures) {
+        fprintf(stderr, "%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("worker pool ok\n");
+    return 0;
+}